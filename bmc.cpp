@@ -7,65 +7,156 @@
 #include <string>
 #include "config.hpp"
 #include <fstream>
+#include <thread>
 #include <boost/spirit/include/qi_parse.hpp>
 #include <bmc/braille/text2braille.hpp>
 #include "bmc/braille/parsing/grammar/score.hpp"
+#include "bmc/braille/parsing/iterator.hpp"
+#include "bmc/braille/parsing/profile.hpp"
 #include "bmc/braille/reformat.hpp"
 #include "bmc/braille/semantic_analysis.hpp"
 #include <boost/program_options.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include "bmc/lilypond.hpp"
+#include "bmc/midi.hpp"
 #include "bmc/musicxml.hpp"
+#if defined(BMC_USE_FLUIDSYNTH)
+#include "fluidsynth.hpp"
+#endif
 #include <boost/locale/encoding_utf.hpp>
 using boost::locale::conv::utf_to_utf;
 
 namespace {
 
-int bmc2ly( std::istream &istream
-          , bool lilypond, bool musicxml
+/// What to produce from a compiled score.
+enum class output { braille, lilypond, midi, musicxml, musicxml_xsd, mxl, wav };
+
+#if defined(BMC_USE_FLUIDSYNTH)
+/// The SoundFont used to render WAV output.
+std::string soundfont = SOUNDFONT_PATH;
+#endif
+
+int bmc2ly( char const *first, char const *last
+          , output target
           , bool include_locations, std::string instrument, bool no_tagline
           , ::bmc::braille::format_style const &style
+          , unsigned jobs
           ) {
-  std::istreambuf_iterator<char> cin_begin(istream.rdbuf()), cin_end;
-  auto const utf8 = std::string(cin_begin, cin_end);
-  auto const source = utf_to_utf<wchar_t>(utf8);
-  typedef std::wstring::const_iterator iterator_type;
+  // Parse the UTF-8 buffer in place, decoding it on the fly.  A truncated
+  // sequence at the end is rejected up front, so decoding never reads past
+  // the buffer, which does not need to be null terminated.
+  typedef ::bmc::braille::utf8_iterator iterator_type;
 
-  iterator_type iter = source.begin();
-  iterator_type const end = source.end();
+  iterator_type iter, end;
+  try {
+    iter = iterator_type(first, first, last);
+    end = iterator_type(last, first, last);
+  } catch (std::out_of_range const &) {
+    std::cerr << "Input is not valid UTF-8" << std::endl;
+    return EXIT_FAILURE;
+  }
   typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
   error_handler_type error_handler(iter, end);
-  typedef ::bmc::braille::score_grammar<iterator_type> parser_type;
-  parser_type parser(error_handler);
-  boost::spirit::traits::attribute_of<parser_type>::type score;
+  ::bmc::braille::ast::score score;
+  ::bmc::braille::compiler<error_handler_type> compile(error_handler);
 
-  bool const success = parse(iter, end, parser, score);
+  // Large scores are annotated section by section while still being parsed.
+  bool success;
+  try {
+    success = ::bmc::braille::parse_score(
+      iter, end, error_handler, score,
+      ::bmc::braille::get_braille_table(::bmc::braille::default_table), jobs,
+      compile.pipeline()
+    );
+  } catch (std::out_of_range const &) {
+    std::cerr << "Input is not valid UTF-8" << std::endl;
+    return EXIT_FAILURE;
+  }
 
   if (success && iter == end) {
-    ::bmc::braille::compiler<error_handler_type> compile(error_handler);
+    // Only the reformatter needs the raw syntax tree.
+    if (target != output::braille) compile.discard_source_tree();
     if (compile(score)) {
       std::wcerr << error_handler;
-      if (lilypond) {
+      switch (target) {
+      case output::lilypond: {
         ::bmc::lilypond::generator generate(std::cout, true, true, include_locations);
         if (!instrument.empty()) generate.instrument(instrument);
         if (no_tagline) generate.remove_tagline();
         generate(score);
-      } else if (musicxml) {
+        break;
+      }
+      case output::midi:
+        ::bmc::midi::standard_midi_file(std::cout, score,
+                                        ::bmc::midi::program(instrument));
+        break;
+      case output::musicxml_xsd:
+        ::bmc::musicxml_via_xsd(std::cout, score);
+        break;
+      case output::musicxml:
         ::bmc::musicxml(std::cout, score);
-      } else {
+        break;
+      case output::mxl:
+        ::bmc::compressed_musicxml(std::cout, score);
+        break;
+      case output::wav:
+#if defined(BMC_USE_FLUIDSYNTH)
+        ::bmc::render_wav(std::cout, score, soundfont,
+                          ::bmc::midi::program(instrument));
+#endif
+        break;
+      case output::braille:
         std::cout << ::bmc::braille::reformat(score, style);
+        break;
       }
 
       return EXIT_SUCCESS;
     }
     std::wcerr << "Failed to compile:" << std::endl << error_handler << std::endl;
   } else {
-    std::wcerr << "Failed to Parse:" << std::endl << source << std::endl;
+    std::wcerr << "Failed to Parse:" << std::endl << utf_to_utf<wchar_t>(first, last) << std::endl;
   }
 
   return EXIT_FAILURE;
 }
 
+int bmc2ly( std::istream &istream
+          , output target
+          , bool include_locations, std::string instrument, bool no_tagline
+          , ::bmc::braille::format_style const &style
+          , unsigned jobs
+          ) {
+  std::string utf8;
+  char buffer[0X10000];
+  while (istream.read(buffer, sizeof(buffer)) || istream.gcount())
+    utf8.append(buffer, istream.gcount());
+
+  return bmc2ly(utf8.data(), utf8.data() + utf8.size(),
+                target, include_locations, instrument, no_tagline,
+                style, jobs);
+}
+
+/**
+ * \brief Map a file into memory, to be parsed without copying it.
+ *
+ * \return An empty region if the file can not be mapped, for instance because
+ *         it is empty or not a regular file.  It should then be read as a
+ *         stream instead.
+ */
+boost::interprocess::mapped_region map_file(std::string const &name) {
+  using namespace boost::interprocess;
+  try {
+    file_mapping file(name.c_str(), read_only);
+    mapped_region region(file, read_only);
+    region.advise(mapped_region::advice_sequential);
+    return region;
+  } catch (interprocess_exception const &) {
+    return {};
+  }
+}
+
 } // namespace
 
 int main(int argc, char const *argv[])
@@ -78,6 +169,7 @@ int main(int argc, char const *argv[])
   bool locations;
   bool no_tagline = false;
   ::bmc::braille::format_style style;
+  unsigned jobs;
   std::vector<std::string> input_files;
 
   options_description desc("Allowed options");
@@ -87,11 +179,27 @@ int main(int argc, char const *argv[])
   ("input-file", value(&input_files), "input file")
   ("instrument,i", value(&instrument), "default MIDI instrument")
   ("lilypond", "Produce LilyPond output.")
+  ("midi", "Produce a Standard MIDI File.")
   ("musicxml", "Produce MusicXML output.")
+  ("musicxml-xsd", "Produce MusicXML output via the XSD object model.")
+  ("mxl", "Produce compressed MusicXML (.mxl) output.")
   ("locations,l", bool_switch(&locations), "Include braille locations in LilyPond output")
   ("no-tagline", bool_switch(&no_tagline)->default_value(false), "Supress LilyPond default tagline")
   ("width,w", value(&style.columns), "Line width for reformatting")
+  ("jobs,j", value(&jobs)->default_value(std::thread::hardware_concurrency()), "Number of threads to parse large inputs with")
   ;
+#if defined(BMC_USE_FLUIDSYNTH)
+  desc.add_options()
+  ("wav", "Render audio to a WAV file.")
+  ("soundfont", value(&soundfont)->default_value(soundfont), "SoundFont to render WAV output with")
+  ;
+#endif
+#if defined(BMC_GRAMMAR_PROFILE)
+  bool grammar_profile = false;
+  desc.add_options()
+  ("grammar-profile", bool_switch(&grammar_profile), "Print how often each grammar rule was tried")
+  ;
+#endif
   positional_options_description positional_desc;
   positional_desc.add("input-file", -1);
 
@@ -110,15 +218,29 @@ int main(int argc, char const *argv[])
   }
 
   int status = EXIT_SUCCESS;
-  bool const do_lilypond { bool(vm.count("lilypond")) }
-           , do_musicxml { bool(vm.count("musicxml")) };
+  output const target { vm.count("lilypond")? output::lilypond
+                      : vm.count("midi")? output::midi
+                      : vm.count("musicxml-xsd")? output::musicxml_xsd
+                      : vm.count("musicxml")? output::musicxml
+                      : vm.count("mxl")? output::mxl
+                      : vm.count("wav")? output::wav
+                      : output::braille };
   for (auto const &file: input_files) {
-    if (file == "-") status = bmc2ly(std::cin, do_lilypond, do_musicxml, locations, instrument, no_tagline, style);
+    if (file == "-") status = bmc2ly(std::cin, target, locations, instrument, no_tagline, style, jobs);
     else {
-      std::ifstream f(file);
-      if (f.good()) status = bmc2ly(f, do_lilypond, do_musicxml, locations, instrument, no_tagline, style);
+      auto const region = map_file(file);
+      if (region.get_size()) {
+        auto const first = static_cast<char const *>(region.get_address());
+        status = bmc2ly(first, first + region.get_size(), target, locations, instrument, no_tagline, style, jobs);
+      } else {
+        std::ifstream f(file);
+        if (f.good()) status = bmc2ly(f, target, locations, instrument, no_tagline, style, jobs);
+      }
     }
   }
+#if defined(BMC_GRAMMAR_PROFILE)
+  if (grammar_profile) ::bmc::braille::write_grammar_profile(std::cerr);
+#endif
 
   return status;
 }
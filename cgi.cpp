@@ -15,6 +15,7 @@
 #include <boost/program_options.hpp>
 
 #include "bmc/lilypond.hpp"
+#include "bmc/midi.hpp"
 
 #include <cgicc/Cgicc.h>
 #include <cgicc/CgiUtils.h>
@@ -157,8 +158,9 @@ int main()
   std::locale::global(std::locale(""));
   cgicc::Cgicc cgi;
 
+  std::string table_name(bmc::braille::default_table);
   if (cgi.getElement("table") != cgi.getElements().end()) {
-    bmc::braille::default_table = cgi.getElement("table")->getValue();
+    table_name = cgi.getElement("table")->getValue();
   }
 
   cgicc::textarea music_input(cgi("music"));
@@ -170,6 +172,9 @@ int main()
   std::string prefix;
   if (braille != cgi.getElements().end()) {
     std::wstring source(boost::locale::conv::utf_to_utf<wchar_t>(braille->getValue()));
+    bmc::braille::braille_table const &table =
+      bmc::braille::get_braille_table(table_name);
+    table.to_unicode_braille(source);
     typedef std::wstring::const_iterator iterator_type;
     iterator_type const end = source.end();
     iterator_type iter = source.begin();
@@ -179,18 +184,29 @@ int main()
     parser_type parser(error_handler);
     boost::spirit::traits::attribute_of<parser_type>::type score;
 
-    bool const success = parse(iter, end, parser, score);
+    bool success;
+    {
+      bmc::braille::braille_table::scope const table_scope(table);
+      success = parse(iter, end, parser, score);
+    }
 
     if (success && iter == end) {
       ::bmc::braille::compiler<error_handler_type> compile(error_handler);
       if (compile(score)) {
+        if (cgi.getElement("type") != cgi.getElements().end() &&
+            cgi.getElement("type")->getValue() == "play") {
+          std::cout << "Content-type: audio/midi" << std::endl << std::endl;
+          ::bmc::midi::standard_midi_file(std::cout, score,
+                                          ::bmc::midi::program(cgi("instrument")));
+          exit(EXIT_SUCCESS);
+        }
         prefix = hash(braille->getValue());
         std::string dir("/tmp/bmc.cgi/");
         std::ofstream bmc(dir + prefix + ".bmc");
         bmc << braille->getValue();
         bmc.close();
         std::ofstream ly(dir + prefix + ".ly");
-        ::bmc::lilypond::generator generate(ly, true, true, false);
+        ::bmc::lilypond::generator generate(ly, true, false, false);
         generate.remove_tagline();
         if (!cgi("instrument").empty())
           generate.instrument(cgi("instrument"));
@@ -203,16 +219,6 @@ int main()
       }
     }
   }
-  if (!prefix.empty() && cgi.getElement("type") != cgi.getElements().end()) {
-    if (cgi.getElement("type")->getValue() == "play") {
-      std::ifstream midi_file("/tmp/bmc.cgi/" + prefix + ".midi");
-      if (midi_file.good()) {
-        std::cout << "Content-type: audio/midi" << std::endl << std::endl;
-        std::cout << midi_file.rdbuf();
-        exit(EXIT_SUCCESS);
-      }
-    }
-  }
   if (!cgi("hash").empty()) {
     if (cgi.getElement("type")->getValue() == "png") {
       std::ifstream png_file("/tmp/bmc.cgi/" + cgi("hash") + ".png");
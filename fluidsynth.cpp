@@ -5,8 +5,14 @@
 //  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
 
 #include "fluidsynth.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <memory>
+#include <stdexcept>
 #include <thread>
-#include <boost/range/numeric.hpp>
 
 namespace bmc {
 
@@ -35,103 +41,181 @@ fluidsynth::~fluidsynth()
   if (settings != 0) delete_fluid_settings(settings);
 }
 
-void
-fluidsynth::operator()(midi::note_on const& note)
-{
-  fluid_synth_noteon(synth, note.channel, note.note, note.velocity);
-  queue.push(midi::note_off(note.begin+note.duration, note.channel, note.note));
-}
-
-void
-fluidsynth::operator()(midi::note_off const& note)
-{ fluid_synth_noteoff(synth, note.channel, note.note); }
-
 void
 fluidsynth::operator()(braille::ast::score const& score)
 {
-  for(braille::ast::part const& part: score.parts) {
-    size_t const staves = part.front().paragraphs.size();
-    for(int i = 0; i < staves; ++i) {
-      current_position = zero;
-      for(braille::ast::section const& section: part) {
-	std::for_each(section.paragraphs[i].begin(), section.paragraphs[i].end(), boost::apply_visitor(*this));
-      }
-    }
-  }
-  ppq = queue.ppq();
-  play();
+  midi::performance const performance(score);
+  rational::int_type const ppq = performance.ppq();
+  std::vector<std::vector<midi::event>> staves;
+  for (auto const& staff: performance.staves)
+    staves.push_back(midi::events(staff, ppq));
+  play(midi::merge(staves), ppq);
 }
 
 void
-fluidsynth::play()
+fluidsynth::play(std::vector<midi::event> const& events, rational::int_type ppq)
 {
   typedef std::chrono::steady_clock clock;
   //static_assert(clock::is_steady, "std::chrono::steady_clock is not steady");
-  clock::duration const ppm(clock::duration::period::den * 60 / ppq);
-  clock::time_point event_time(clock::now());
-  rational position;
-  rational pulse(rational(1, 4) / ppq);
-  while (!queue.empty()) {
-    midi::event const event(queue.top());
-    queue.pop();
-    rational const delta = event.begin() - position;
-    if (delta > 0) {
-      position += delta;
-      event_time += ppm / bpm * boost::rational_cast<rational::int_type>(delta / pulse);
-      std::this_thread::sleep_until(event_time);
+  clock::time_point const start(clock::now());
+  std::uint32_t tick = 0;
+  for (midi::event const& event: events) {
+    if (event.tick != tick) {
+      tick = event.tick;
+      std::this_thread::sleep_until(start + std::chrono::microseconds(
+        std::int64_t(tick) * 60000000 / (bpm * ppq)
+      ));
     }
-    event.apply_visitor(*this);
+    if (event.note_on())
+      fluid_synth_noteon(synth, event.channel(), event.key, event.velocity);
+    else
+      fluid_synth_noteoff(synth, event.channel(), event.key);
   }
   std::this_thread::sleep_for(std::chrono::seconds(1));
 }
 
-class midi_performer : public boost::static_visitor<void>
+namespace {
+
+/**
+ * \brief Renders the events of one staff with a synthesizer of its own,
+ *        which is not connected to an audio driver.
+ */
+class staff_renderer
 {
-  midi::event_queue& queue;
-  rational& position;
+  fluid_settings_t *settings;
+  fluid_synth_t *synth;
+  std::vector<midi::event> events;
+  std::vector<midi::event>::const_iterator next;
+  std::uint64_t frame = 0;
+  std::uint64_t const frames_per_minute, ticks_per_minute;
+
 public:
-  midi_performer(midi::event_queue& queue, rational& position)
-  : queue(queue), position(position) {}
-  result_type operator()(braille::ast::note const& note) const
+  staff_renderer( std::string const& soundfont, unsigned sample_rate
+                , int channel, int program
+                , std::vector<midi::event>&& staff_events
+                , rational::int_type ppq, unsigned bpm
+                )
+  : settings(new_fluid_settings())
+  , synth(nullptr)
+  , events(std::move(staff_events))
+  , next(events.begin())
+  , frames_per_minute(std::uint64_t(sample_rate) * 60)
+  , ticks_per_minute(std::uint64_t(ppq) * bpm)
   {
-    int const chromatic[7] = { 0, 2, 4, 6, 7, 9, 11 };
-    queue.push(midi::note_on(position, 0,
-                             (note.octave*12) + chromatic[note.step] + note.alter,
-                             90, note.as_rational()));
-    position += note.as_rational();
+    fluid_settings_setnum(settings, "synth.sample-rate", sample_rate);
+    synth = new_fluid_synth(settings);
+    if (fluid_synth_sfload(synth, soundfont.c_str(), 1) == FLUID_FAILED) {
+      delete_fluid_synth(synth);
+      delete_fluid_settings(settings);
+      throw std::runtime_error("Unable to load soundfont " + soundfont);
+    }
+    fluid_synth_program_change(synth, channel, program);
   }
-  result_type operator()(braille::ast::rest const& rest) const
-  { position += rest.as_rational(); }
-  result_type operator()(braille::ast::chord const& chord) const
+  staff_renderer(staff_renderer const&) = delete;
+  staff_renderer& operator=(staff_renderer const&) = delete;
+  ~staff_renderer()
   {
-    (*this)(chord.base);
-    // ...
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+  }
+
+  std::uint64_t frame_of(std::uint32_t tick) const
+  { return tick * frames_per_minute / ticks_per_minute; }
+
+  /**
+   * \brief Render interleaved stereo samples up to (excluding) frame
+   *        <code>end</code>, continuing where the last call stopped.
+   */
+  void operator()(float *buffer, std::uint64_t end)
+  {
+    float *const first = buffer;
+    std::uint64_t const begin = frame;
+    auto const write = [&](std::uint64_t until) {
+      if (until > frame) {
+        int const count = until - frame;
+        float *const out = first + 2 * (frame - begin);
+        fluid_synth_write_float(synth, count, out, 0, 2, out, 1, 2);
+        frame = until;
+      }
+    };
+    for (; next != events.end() && frame_of(next->tick) < end; ++next) {
+      write(frame_of(next->tick));
+      if (next->note_on())
+        fluid_synth_noteon(synth, next->channel(), next->key, next->velocity);
+      else
+        fluid_synth_noteoff(synth, next->channel(), next->key);
+    }
+    write(end);
   }
-  template<typename T> result_type operator()(T const&) const {}
 };
 
+void little_endian(std::ostream& os, std::uint32_t value, int bytes)
+{
+  for (int i = 0; i < bytes; ++i) os.put(char(value >> (8 * i) & 0XFF));
 }
 
-
-namespace bmc {
+}
 
 void
-fluidsynth::operator()(braille::ast::measure const& measure)
+render_wav( std::ostream& os, braille::ast::score const& score
+          , std::string const& soundfont
+          , int program, unsigned beats_per_minute, unsigned sample_rate
+          )
 {
-  for (braille::ast::voice const& voice: measure.voices) {
-    rational voice_position(current_position);
-    for (braille::ast::partial_measure const& partial_measure: voice) {
-      for (braille::ast::partial_voice const& partial_voice: partial_measure) {
-        rational position(voice_position);
-        midi_performer perform(queue, position);
-        std::for_each(partial_voice.begin(), partial_voice.end(),
-                      boost::apply_visitor(perform));
-      }
-      voice_position += duration(partial_measure);      
+  midi::performance const performance(score);
+  rational::int_type const ppq = performance.ppq();
+  std::vector<std::unique_ptr<staff_renderer>> staves;
+  std::uint64_t frames = 0;
+  for (auto const& staff: performance.staves) {
+    staves.emplace_back(new staff_renderer(soundfont, sample_rate,
+                                           staff.channel, program,
+                                           midi::events(staff, ppq),
+                                           ppq, beats_per_minute));
+    frames = std::max(frames, staves.back()->frame_of(midi::ticks(staff.end, ppq)));
+  }
+  // Let the last notes ring out.
+  frames += sample_rate;
+
+  std::uint64_t const data_size = frames * 4;
+  if (data_size > std::numeric_limits<std::uint32_t>::max() - 36)
+    throw std::runtime_error("Score too long for a WAV file");
+  os.write("RIFF", 4); little_endian(os, 36 + data_size, 4);
+  os.write("WAVE", 4);
+  os.write("fmt ", 4); little_endian(os, 16, 4);
+  little_endian(os, 1, 2);                    // PCM
+  little_endian(os, 2, 2);                    // Stereo
+  little_endian(os, sample_rate, 4);
+  little_endian(os, sample_rate * 4, 4);      // Bytes per second
+  little_endian(os, 4, 2);                    // Bytes per frame
+  little_endian(os, 16, 2);                   // Bits per sample
+  os.write("data", 4); little_endian(os, data_size, 4);
+
+  // Staves are rendered in parallel, a block at a time, so that memory use
+  // does not depend on the length of the score.
+  std::uint64_t const block = 1 << 16;
+  std::vector<std::vector<float>> buffers(staves.size(),
+                                          std::vector<float>(2 * block));
+  std::vector<char> mixed(4 * block);
+  for (std::uint64_t begin = 0; begin < frames; begin += block) {
+    std::uint64_t const end = std::min(frames, begin + block);
+    std::vector<std::future<void>> rendered;
+    for (std::size_t index = 0; index < staves.size(); ++index)
+      rendered.push_back(std::async(std::launch::async,
+                                    std::ref(*staves[index]),
+                                    buffers[index].data(), end));
+    for (auto& staff: rendered) staff.get();
+
+    std::size_t const samples = 2 * (end - begin);
+    for (std::size_t sample = 0; sample < samples; ++sample) {
+      float value = 0;
+      for (auto const& buffer: buffers) value += buffer[sample];
+      value = std::max(-1.0f, std::min(1.0f, value));
+      std::uint16_t const pcm = std::int16_t(value * 32767);
+      mixed[2 * sample] = char(pcm & 0XFF);
+      mixed[2 * sample + 1] = char(pcm >> 8);
     }
+    os.write(mixed.data(), 2 * samples);
   }
-  current_position += duration(measure);
 }
 
 }
-
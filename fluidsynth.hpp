@@ -6,19 +6,16 @@
 
 #include <fluidsynth.h>
 #include "bmc/braille/ast.hpp"
-#include "midi.hpp"
+#include "bmc/midi.hpp"
 
 namespace bmc {
 
 class fluidsynth
-: public boost::static_visitor<void>
 {
   fluid_settings_t *settings;
   fluid_synth_t *synth;
   fluid_audio_driver_t *audio_driver;
-  midi::event_queue queue;
-  unsigned int ppq, bpm;
-  rational current_position;
+  unsigned int bpm;
 public:
   fluidsynth(std::string const& soundfont);
   fluidsynth(fluidsynth const&) = delete;
@@ -26,15 +23,24 @@ public:
   fluidsynth(fluidsynth&&);
   ~fluidsynth();
 
-  void operator()(midi::note_on const&);
-  void operator()(midi::note_off const&);
-
   void operator()(braille::ast::score const&);
-  void operator()(braille::ast::measure const&);
-  result_type operator()(braille::ast::key_and_time_signature const&) {};
 private:
-  void play();
+  void play(std::vector<midi::event> const&, rational::int_type ppq);
 };
 
+/**
+ * \brief Render a score to a 16 bit stereo WAV file, without an audio device.
+ *
+ * Every staff is played by a synthesizer of its own.  The staves are
+ * rendered in parallel, one block of samples at a time, and mixed.
+ * Rendering runs as fast as the CPU allows, and the stream does not need to
+ * be seekable.
+ */
+void render_wav( std::ostream&, braille::ast::score const&
+               , std::string const& soundfont
+               , int program = 0, unsigned beats_per_minute = 60
+               , unsigned sample_rate = 44100
+               );
+
 }
 
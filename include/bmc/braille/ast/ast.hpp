@@ -68,18 +68,18 @@ struct rhythmic_data
 };
 
 /** \brief Base class for everything that implies a rhythmic value.
+ *
+ * Derived classes provide <code>as_rational()</code>, <code>get_dots()</code>,
+ * <code>get_type()</code> and <code>get_factor()</code>.  There is
+ * deliberately no virtual interface: these nodes are stored by value in
+ * variants, so code dealing with rhythmic values in general is written as
+ * templates restricted with is_rhythmic_type, which avoids a vtable pointer
+ * in every node and allows the accessors to be inlined.
  */
-class rhythmic
-{
-protected:
-  //rhythmic() {}
-  virtual ~rhythmic();
-public:
-  virtual rational as_rational() const = 0;
-  virtual unsigned get_dots() const = 0;
-  virtual rational get_type() const = 0;
-  virtual rational get_factor() const = 0;
-};
+struct rhythmic {};
+
+template <typename T>
+using is_rhythmic_type = std::is_base_of<rhythmic, T>;
 
 struct slur : locatable
 {
@@ -115,14 +115,12 @@ struct stem final : rhythmic
   unsigned dots;
   boost::optional<ast::tie> tied;
 
-  virtual ~stem();
-
-  rational as_rational() const override
+  rational as_rational() const
   { return type * augmentation_dots_factor(dots); }
-  unsigned get_dots() const override
+  unsigned get_dots() const
   { return dots; }
-  rational get_factor() const override { return 1; }
-  rational get_type() const override { return type; }
+  rational get_factor() const { return 1; }
+  rational get_type() const { return type; }
 };
 
 struct note final : locatable, rhythmic_data, rhythmic, pitched
@@ -133,12 +131,11 @@ struct note final : locatable, rhythmic_data, rhythmic, pitched
   std::vector<stem> extra_stems;
 
   note(): locatable(), rhythmic_data(), pitched() {}
-  virtual ~note();
-  rational as_rational() const override
+  rational as_rational() const
   { return type * augmentation_dots_factor(dots) * factor; }
-  unsigned get_dots() const override { return dots; }
-  rational get_factor() const override { return factor; }
-  rational get_type() const override { return type; }
+  unsigned get_dots() const { return dots; }
+  rational get_factor() const { return factor; }
+  rational get_type() const { return type; }
 };
 
 struct rest final : locatable, rhythmic_data, rhythmic
@@ -146,14 +143,13 @@ struct rest final : locatable, rhythmic_data, rhythmic
   bool by_transcriber;
 
   rest(): locatable(), rhythmic_data(), whole_measure(false) {}
-  virtual ~rest();
   bool whole_measure; // filled in by disambiguate.hpp
-  rational as_rational() const override
+  rational as_rational() const
   { return type * augmentation_dots_factor(dots) * factor; }
-  unsigned get_dots() const override
+  unsigned get_dots() const
   { return dots; }
-  rational get_factor() const override { return factor; }
-  rational get_type() const override
+  rational get_factor() const { return factor; }
+  rational get_type() const
   { return whole_measure? rational{1}: type; }
 };
 
@@ -169,12 +165,10 @@ struct chord final : locatable, rhythmic
   std::vector<interval> intervals;
   bool all_tied = false;
 
-  virtual ~chord();
-
-  rational as_rational() const override { return base.as_rational(); }
-  unsigned get_dots() const override { return base.get_dots(); }
-  rational get_factor() const override { return base.factor; }
-  rational get_type() const override { return base.type; }
+  rational as_rational() const { return base.as_rational(); }
+  unsigned get_dots() const { return base.get_dots(); }
+  rational get_factor() const { return base.factor; }
+  rational get_type() const { return base.type; }
 
   enum class arpeggio_type { up, down };
   boost::optional<arpeggio_type> arpeggio() const {
@@ -198,12 +192,10 @@ struct moving_note final : locatable, rhythmic
   note base;
   std::vector<interval> intervals;
 
-  virtual ~moving_note();
-
-  rational as_rational() const override { return base.as_rational(); }
-  unsigned get_dots() const override { return base.get_dots(); }
-  rational get_factor() const override { return base.factor; }
-  rational get_type() const override { return base.type; }
+  rational as_rational() const { return base.as_rational(); }
+  unsigned get_dots() const { return base.get_dots(); }
+  rational get_factor() const { return base.factor; }
+  rational get_type() const { return base.type; }
 };
 
 struct value_prefix : locatable
@@ -264,11 +256,31 @@ typedef boost::variant< note, rest, chord, moving_note
                       >
         sign;
 
-struct partial_voice : locatable, std::vector<sign> {};
-struct partial_measure : locatable, std::vector<partial_voice> {};
-struct voice : locatable, std::vector<partial_measure> {};
+/** \brief Remembers the duration of a container of rhythmic values.
+ *
+ * The duration of a partial voice, partial measure, voice or measure is only
+ * known after value disambiguation, and is queried over and over again by
+ * later passes and the output generators.  The compiler therefore stores it
+ * once the values of a measure have been accepted (see cache_durations() in
+ * bmc/braille/ast/duration.hpp).  Code which changes rhythmic values or the
+ * contents of a container after that point must call reset_duration() on
+ * the container and all of its ancestors.
+ */
+class duration_cache
+{
+  boost::optional<rational> known;
+
+public:
+  boost::optional<rational> const &cached_duration() const { return known; }
+  void cache_duration(rational const &value) { known = value; }
+  void reset_duration() { known = boost::none; }
+};
+
+struct partial_voice : locatable, duration_cache, std::vector<sign> {};
+struct partial_measure : locatable, duration_cache, std::vector<partial_voice> {};
+struct voice : locatable, duration_cache, std::vector<partial_measure> {};
 
-struct measure : locatable
+struct measure : locatable, duration_cache
 {
   boost::optional<unsigned> ending;
   std::vector<voice> voices;
@@ -280,7 +292,17 @@ struct key_and_time_signature : locatable
   time_signature time;
 };
 
-typedef boost::variant<measure, key_and_time_signature> paragraph_element;
+/**
+ * \brief Input which could not be parsed as a measure.
+ *
+ * Only produced by score_parser while recovering from parse errors, which
+ * have been reported already.  A staff containing such a node can not be
+ * compiled.
+ */
+struct unparsable : locatable {};
+
+typedef boost::variant<measure, key_and_time_signature, unparsable>
+        paragraph_element;
 typedef std::vector<paragraph_element> paragraph;
 
 struct measure_specification : locatable
@@ -324,7 +346,7 @@ typedef boost::make_variant_over
         , tuplet_start>::type
         >::type sign;
 
-struct partial_voice : locatable, std::vector<sign>
+struct partial_voice : locatable, duration_cache, std::vector<sign>
 {
   partial_voice()
   : std::vector<sign>()
@@ -333,10 +355,10 @@ struct partial_voice : locatable, std::vector<sign>
   : std::vector<sign>(begin, end)
   {}
 };
-struct partial_measure : locatable, std::vector<partial_voice> {};
-struct voice : locatable, std::vector<partial_measure> {};
+struct partial_measure : locatable, duration_cache, std::vector<partial_voice> {};
+struct voice : locatable, duration_cache, std::vector<partial_measure> {};
 
-struct measure : locatable
+struct measure : locatable, duration_cache
 {
   boost::optional<unsigned> ending;
   std::vector<voice> voices;
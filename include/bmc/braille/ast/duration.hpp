@@ -15,7 +15,9 @@ namespace bmc {
     namespace ast {
       struct get_duration: boost::static_visitor<rational>
       {
-        result_type operator() (rhythmic const& note) const
+        template <typename Rhythmic>
+        typename std::enable_if<is_rhythmic_type<Rhythmic>::value, result_type>::type
+        operator() (Rhythmic const& note) const
         { return note.as_rational(); }
         result_type operator() (barline const&) const { return result_type(); }
         result_type operator() (hand_sign const&) const { return result_type(); }
@@ -29,6 +31,7 @@ namespace bmc {
         result_type operator() (measure const&) const;
         result_type operator() (unfolded::measure const&) const;
         result_type operator() (key_and_time_signature const&) const { return result_type(); }
+        result_type operator() (unparsable const&) const { return result_type(); }
       };
 
       inline
@@ -78,6 +81,8 @@ namespace bmc {
       duration(partial_voice const& partial_voice)
       {
         // BOOST_ASSERT(!partial_voice.empty());
+        if (partial_voice.cached_duration())
+          return *partial_voice.cached_duration();
         return boost::accumulate(partial_voice, rational());
       }
       inline
@@ -85,6 +90,8 @@ namespace bmc {
       duration(unfolded::partial_voice const& partial_voice)
       {
         // BOOST_ASSERT(!partial_voice.empty());
+        if (partial_voice.cached_duration())
+          return *partial_voice.cached_duration();
         return boost::accumulate(partial_voice, rational());
       }
 
@@ -93,6 +100,8 @@ namespace bmc {
       duration(partial_measure const& partial_measure)
       {
         BOOST_ASSERT(!partial_measure.empty());
+        if (partial_measure.cached_duration())
+          return *partial_measure.cached_duration();
         return duration(partial_measure.front());
       }
       inline
@@ -100,6 +109,8 @@ namespace bmc {
       duration(unfolded::partial_measure const& partial_measure)
       {
         BOOST_ASSERT(!partial_measure.empty());
+        if (partial_measure.cached_duration())
+          return *partial_measure.cached_duration();
         return duration(partial_measure.front());
       }
     }
@@ -134,12 +145,14 @@ namespace bmc {
       rational
       duration(voice const& voice)
       {
+        if (voice.cached_duration()) return *voice.cached_duration();
         return boost::accumulate(voice, rational());
       }
       inline
       rational
       duration(unfolded::voice const& voice)
       {
+        if (voice.cached_duration()) return *voice.cached_duration();
         return boost::accumulate(voice, rational());
       }
 
@@ -148,6 +161,7 @@ namespace bmc {
       duration(measure const& measure)
       {
         BOOST_ASSERT(!measure.voices.empty());
+        if (measure.cached_duration()) return *measure.cached_duration();
         return duration(measure.voices.front());
       }
       inline
@@ -155,6 +169,7 @@ namespace bmc {
       duration(unfolded::measure const& measure)
       {
         BOOST_ASSERT(!measure.voices.empty());
+        if (measure.cached_duration()) return *measure.cached_duration();
         return duration(measure.voices.front());
       }
 
@@ -223,6 +238,41 @@ namespace bmc {
       {
         return boost::accumulate(staff, rational());
       }
+
+      namespace detail {
+        template <typename Container>
+        void recache_duration(Container &container)
+        {
+          container.reset_duration();
+          container.cache_duration(duration(container));
+        }
+
+        template <typename Measure>
+        void cache_durations(Measure &measure)
+        {
+          for (auto &voice: measure.voices) {
+            for (auto &partial_measure: voice) {
+              for (auto &partial_voice: partial_measure)
+                recache_duration(partial_voice);
+              recache_duration(partial_measure);
+            }
+            recache_duration(voice);
+          }
+          recache_duration(measure);
+        }
+      }
+
+      /** \brief Store the duration of a measure and all of its containers.
+       *
+       * Must only be called once all rhythmic values in the measure are
+       * known, afterwards duration() of these containers is O(1).
+       *
+       * \see duration_cache
+       */
+      inline void cache_durations(measure &measure)
+      { detail::cache_durations(measure); }
+      inline void cache_durations(unfolded::measure &measure)
+      { detail::cache_durations(measure); }
     }
   }
 }
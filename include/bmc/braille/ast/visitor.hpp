@@ -113,8 +113,7 @@ public:
     return derived().walk_up_from_note(n);
   }
   bool walk_up_from_note(Ref<ast::note> n) {
-    return derived().walk_up_from_rhythmic(
-               static_cast<Ref<ast::rhythmic>>(n)) &&
+    return derived().walk_up_from_rhythmic(n) &&
            derived().walk_up_from_pitched(static_cast<Ref<ast::pitched>>(n)) &&
            derived().walk_up_from_locatable(static_cast<Ref<ast::locatable>>(n)) &&
            derived().visit_note(n);
@@ -125,14 +124,20 @@ public:
     return derived().walk_up_from_rest(r);
   }
   bool walk_up_from_rest(Ref<ast::rest> r) {
-    return derived().walk_up_from_rhythmic(
-               static_cast<Ref<ast::rhythmic>>(r)) &&
+    return derived().walk_up_from_rhythmic(r) &&
            derived().walk_up_from_locatable(static_cast<Ref<ast::locatable>>(r)) &&
            derived().visit_rest(r);
   }
   bool visit_rest(Ref<ast::rest>) { return true; }
 
-  SIMPLE_BASE(rhythmic, ast::rhythmic, r)
+  // ast::rhythmic has no virtual interface, so the rhythmic hooks receive
+  // the concrete node (note or rest) and overrides need to be templates.
+  template <typename Rhythmic> bool walk_up_from_rhythmic(Rhythmic &r) {
+    static_assert(is_rhythmic_type<typename std::decay<Rhythmic>::type>::value,
+                  "Not a rhythmic node");
+    return derived().visit_rhythmic(r);
+  }
+  template <typename Rhythmic> bool visit_rhythmic(Rhythmic &) { return true; }
   SIMPLE_BASE(pitched, ast::pitched, p)
   SIMPLE_BASE(locatable, ast::locatable, l)
 
@@ -184,6 +189,15 @@ public:
     return true;
   }
 
+  bool traverse_unparsable(Ref<ast::unparsable> u) {
+    return derived().walk_up_from_unparsable(u);
+  }
+  bool walk_up_from_unparsable(Ref<ast::unparsable> u) {
+    return derived().walk_up_from_locatable(static_cast<Ref<ast::locatable>>(u)) &&
+           derived().visit_unparsable(u);
+  }
+  bool visit_unparsable(Ref<ast::unparsable>) { return true; }
+
 #undef SIMPLE_CONTAINER
 #undef SIMPLE_VARIANT
 #undef SIMPLE_BASE
@@ -203,6 +217,7 @@ public:
   BEGIN_STATIC_VISITOR(paragraph_element_visitor_type)
   CALL_OPERATOR(ast::measure, measure)
   CALL_OPERATOR(ast::key_and_time_signature, key_and_time_signature)
+  CALL_OPERATOR(ast::unparsable, unparsable)
   END_STATIC_VISITOR(paragraph_element_visitor)
 
   BEGIN_STATIC_VISITOR(sign_visitor_type)
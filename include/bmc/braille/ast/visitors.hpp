@@ -48,7 +48,9 @@ namespace bmc {
 
       struct get_augmentation_dots : boost::static_visitor<unsigned>
       {
-        result_type operator()(rhythmic const& rhythm) const { return rhythm.get_dots(); }
+        template <typename Rhythmic>
+        typename std::enable_if<is_rhythmic_type<Rhythmic>::value, result_type>::type
+        operator()(Rhythmic const& rhythm) const { return rhythm.get_dots(); }
         result_type operator()(barline const&) const { return 0; }
         result_type operator()(hand_sign const&) const { return 0; }
         result_type operator()(hyphen const&) const { return 0; }
@@ -63,7 +65,7 @@ namespace bmc {
       {
         template <typename T>
         result_type operator()(T const&) const
-        { return std::is_base_of<rhythmic, T>::value; }
+        { return is_rhythmic_type<T>::value; }
       };
 
       inline bool is_grace(note const &n)
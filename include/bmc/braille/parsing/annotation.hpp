@@ -11,6 +11,7 @@
 #include <boost/variant/apply_visitor.hpp>
 #include <boost/mpl/bool.hpp>
 #include "bmc/braille/ast.hpp"
+#include "bmc/braille/parsing/error_handler.hpp"
 
 namespace bmc { namespace braille {
 
@@ -20,9 +21,9 @@ struct annotation
   template <typename>
   struct result { typedef void type; };
 
-  std::vector<boost::iterator_range<Iterator>>& ranges;
-  annotation(std::vector<boost::iterator_range<Iterator>>& ranges)
-  : ranges(ranges)
+  error_handler<Iterator>& handler;
+  annotation(error_handler<Iterator>& handler)
+  : handler(handler)
   {
   }
 
@@ -30,9 +31,7 @@ struct annotation
                  , Iterator begin, Iterator end
                  ) const
   {
-    std::size_t id = ranges.size();
-    ranges.emplace_back(begin, end);
-    ast.id = id;
+    ast.id = handler.target().annotate(begin, end);
   }
 };
 
@@ -7,14 +7,63 @@
 #if !defined(BMC_ERROR_HANDLER_HPP)
 #define BMC_ERROR_HANDLER_HPP
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <boost/assert.hpp>
+#include <boost/locale/encoding_utf.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <boost/regex/pending/unicode_iterator.hpp>
 
 namespace bmc { namespace braille {
 
+  /**
+   * \brief Where an annotated syntax tree node was found in the input.
+   *
+   * Offset and length count code units of the underlying buffer, relative
+   * to the start of the input, which keeps entries small no matter how
+   * large the iterators used for parsing are.
+   */
+  struct source_range
+  {
+    std::uint32_t offset, length;
+  };
+
+  namespace detail {
+    // Conversion between iterators and offsets into the buffer they
+    // traverse.  Iterators decoding UTF-8 on the fly are converted via the
+    // position in their underlying buffer, so that both directions take
+    // constant time.
+    template <typename Iterator>
+    struct code_units
+    {
+      static constexpr std::size_t per_character = 1;
+      static std::size_t distance(Iterator first, Iterator i)
+      { return std::distance(first, i); }
+      static Iterator advance(Iterator first, std::size_t n)
+      { return std::next(first, n); }
+    };
+
+    template <typename BaseIterator, typename U32>
+    struct code_units<boost::u8_to_u32_iterator<BaseIterator, U32>>
+    {
+      typedef boost::u8_to_u32_iterator<BaseIterator, U32> iterator_type;
+      // Braille patterns take three bytes in UTF-8.
+      static constexpr std::size_t per_character = 3;
+      static std::size_t distance(iterator_type first, iterator_type i)
+      { return std::distance(first.base(), i.base()); }
+      static iterator_type advance(iterator_type first, std::size_t n)
+      { return iterator_type(std::next(first.base(), n)); }
+    };
+  }
+
   ///////////////////////////////////////////////////////////////////////////////
   //  The error handler
   ///////////////////////////////////////////////////////////////////////////////
@@ -22,7 +71,8 @@ namespace bmc { namespace braille {
   struct error_handler
   {
     typedef Iterator iterator_type;
-    typedef std::basic_string<typename iterator_type::value_type> string_type;
+    // Diagnostics are always wide strings, whatever the input encoding is.
+    typedef std::wstring string_type;
 
     template <typename>
     struct result { typedef void type; };
@@ -30,14 +80,65 @@ namespace bmc { namespace braille {
     error_handler(iterator_type f, iterator_type l)
     : first(f), last(l)
     , messages{std::make_shared<std::vector<string_type>>()}
+    {
+      std::size_t const size = code_units::distance(first, last);
+      BOOST_ASSERT(size <= std::numeric_limits<std::uint32_t>::max());
+      // Typical scores annotate about one node per character of input, so
+      // ranges rarely has to grow while parsing.
+      ranges.reserve(size / code_units::per_character);
+    }
+
+    /**
+     * \brief Construct an error handler for grammars meant to be reused.
+     *
+     * Grammars bound to such an error handler are not tied to any input.
+     * They record diagnostics and source ranges in the current error handler
+     * of the thread they are parsing on instead, see scope.
+     */
+    error_handler()
+    : first(), last()
+    , messages{std::make_shared<std::vector<string_type>>()}
+    , deferred(true)
     {}
 
+    /**
+     * \brief Make an error handler current on this thread for the lifetime
+     *        of this object.
+     */
+    class scope
+    {
+      error_handler *previous;
+
+    public:
+      explicit scope(error_handler &handler)
+      : previous(current())
+      { current() = &handler; }
+      ~scope() { current() = previous; }
+
+      scope(scope const &) = delete;
+      scope &operator=(scope const &) = delete;
+    };
+
+    /**
+     * \brief The error handler diagnostics and source ranges end up in.
+     */
+    error_handler &target()
+    {
+      BOOST_ASSERT(!deferred || current());
+      return deferred? *current(): *this;
+    }
+
     template <typename Message, typename What>
     void operator()( Message const& message
                    , What const& what
                    , iterator_type err_pos
                    ) const
     {
+      if (deferred) {
+        BOOST_ASSERT(current());
+        return (*current())(message, what, err_pos);
+      }
+
       int line;
       iterator_type line_start = get_pos(err_pos, line);
       if (err_pos != last) {
@@ -61,24 +162,26 @@ namespace bmc { namespace braille {
       }
     }
 
+    /**
+     * \brief Find the line <code>err_pos</code> is on.
+     *
+     * Lines are looked up in an index which is built on first use, so that
+     * calculating the locations of all nodes does not take quadratic time.
+     *
+     * \return The start of the line.
+     */
     iterator_type get_pos(iterator_type err_pos, int& line) const
     {
-      line = 1;
-      iterator_type i = first;
-      iterator_type line_start = first;
-      while (i != err_pos) {
-        bool eol = false;
-        if (i != err_pos && *i == '\r') {
-          eol = true;
-          line_start = ++i;
-        }
-        if (i != err_pos && *i == '\n') {
-          eol = true;
-          line_start = ++i;
+      std::call_once(lines->built, [this]() { index_lines(); });
+      std::size_t const offset = code_units::distance(first, err_pos);
+      auto const start = std::prev(std::upper_bound(
+        lines->starts.begin(), lines->starts.end(), offset,
+        [](std::size_t offset, line_start const &start) {
+          return offset < start.offset;
         }
-        if (eol) ++line; else ++i;
-      }
-      return line_start;
+      ));
+      line = start->line;
+      return code_units::advance(first, start->offset);
     }
 
     string_type get_line(iterator_type line_start) const
@@ -86,7 +189,47 @@ namespace bmc { namespace braille {
       iterator_type line_end = line_start;
       for (; line_end != last && (*line_end != '\r' && *line_end != '\n');
            ++line_end);
-      return string_type(line_start, line_end);
+      typedef typename std::iterator_traits<iterator_type>::value_type char_type;
+      return boost::locale::conv::utf_to_utf<string_type::value_type>
+             (std::basic_string<char_type>(line_start, line_end));
+    }
+
+    /**
+     * \brief Record where an annotated syntax tree node was found.
+     *
+     * \return The id of the node, indexing ranges.
+     */
+    int annotate(iterator_type begin, iterator_type end)
+    {
+      std::size_t const offset = code_units::distance(first, begin);
+      std::size_t const length = code_units::distance(begin, end);
+      BOOST_ASSERT(offset + length <= std::numeric_limits<std::uint32_t>::max());
+      ranges.push_back({std::uint32_t(offset), std::uint32_t(length)});
+      return ranges.size() - 1;
+    }
+
+    /**
+     * \brief The part of the input the node with <code>id</code> was
+     *        parsed from.
+     */
+    boost::iterator_range<iterator_type> range(int id) const
+    {
+      BOOST_ASSERT(id >= 0 && std::size_t(id) < ranges.size());
+      source_range const &range = ranges[id];
+      iterator_type const begin = code_units::advance(first, range.offset);
+      return { begin, code_units::advance(begin, range.length) };
+    }
+
+    /**
+     * \brief Free the source ranges of all annotated syntax tree nodes.
+     *
+     * Once the raw syntax tree has been compiled and discarded nothing
+     * refers to these ranges anymore.  Messages already recorded are kept.
+     */
+    void release_ranges()
+    {
+      ranges.clear();
+      ranges.shrink_to_fit();
     }
 
     friend std::wostream &operator<<(std::wostream &os, error_handler const &eh)
@@ -96,8 +239,61 @@ namespace bmc { namespace braille {
     }
 
     iterator_type first, last;
-    std::vector<boost::iterator_range<iterator_type>> ranges;
+    std::vector<source_range> ranges;
     std::shared_ptr<std::vector<string_type>> messages;
+    /**
+     * \brief Whether grammars skip over measures they can not parse instead
+     *        of failing, see score_parser.
+     */
+    bool recover = false;
+
+  private:
+    typedef detail::code_units<iterator_type> code_units;
+
+    struct line_start
+    {
+      std::uint32_t offset;
+      int line;
+    };
+    struct line_index
+    {
+      std::once_flag built;
+      std::vector<line_start> starts;
+    };
+    std::shared_ptr<line_index> lines = std::make_shared<line_index>();
+
+    // A line starts after every CR and LF, but CR LF only counts as a single
+    // line break.
+    void index_lines() const
+    {
+      lines->starts.push_back({0, 1});
+      int line = 1;
+      iterator_type i = first;
+      while (i != last) {
+        bool eol = false;
+        if (*i == '\r') {
+          eol = true;
+          ++i;
+          lines->starts.push_back
+          ({std::uint32_t(code_units::distance(first, i)), line + 1});
+        }
+        if (i != last && *i == '\n') {
+          eol = true;
+          ++i;
+          lines->starts.push_back
+          ({std::uint32_t(code_units::distance(first, i)), line + 1});
+        }
+        if (eol) ++line; else ++i;
+      }
+    }
+
+    bool deferred = false;
+
+    static error_handler *&current()
+    {
+      static thread_local error_handler *handler = nullptr;
+      return handler;
+    }
   };
 
 }}
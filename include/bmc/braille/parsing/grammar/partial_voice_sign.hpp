@@ -32,8 +32,7 @@ struct partial_voice_sign_grammar : boost::spirit::qi::grammar<Iterator, ast::si
   boost::spirit::qi::rule<Iterator, ast::stem()> stem;
   boost::spirit::qi::rule<Iterator, bool()> added_by_transcriber;
   boost::spirit::qi::rule<Iterator, ast::rest()> rest;
-  boost::spirit::qi::rule<Iterator, ast::chord()> chord;
-  boost::spirit::qi::rule<Iterator, ast::moving_note()> moving_note;
+  boost::spirit::qi::rule<Iterator, ast::sign(), boost::spirit::qi::locals<ast::note>> note_or_chord;
   boost::spirit::qi::rule<Iterator, std::vector<ast::interval>()> moving_intervals;
   boost::spirit::qi::rule<Iterator, ast::interval()> interval;
   boost::spirit::qi::rule<Iterator, unsigned()> finger_sign;
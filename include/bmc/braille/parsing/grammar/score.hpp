@@ -8,15 +8,26 @@
 #define BMC_SCORE_HPP
 
 #include "config.hpp"
+#include <thread>
+#include <utility>
+#include <vector>
 #include <boost/spirit/include/qi_grammar.hpp>
+#include <boost/spirit/include/qi_parse.hpp>
 #include "bmc/braille/ast/ast.hpp"
 #include "bmc/braille/parsing/error_handler.hpp"
 #include "bmc/braille/parsing/grammar/measure.hpp"
 #include "bmc/braille/parsing/grammar/key_signature.hpp"
 #include "bmc/braille/parsing/grammar/time_signature.hpp"
+#include "bmc/braille/parsing/section_pipeline.hpp"
+#include "bmc/braille/text2braille.hpp"
 
 namespace bmc { namespace braille {
 
+/**
+ * \brief A run of consecutive sections, not yet grouped into parts.
+ */
+typedef std::vector<std::pair<section_kind, ast::section>> section_list;
+
 /**
  * \brief Top-level grammar for parsing braille music scores.
  *
@@ -27,11 +38,21 @@ struct score_grammar : boost::spirit::qi::grammar<Iterator, ast::score()>
 {
   score_grammar(error_handler<Iterator>&);
 
-  boost::spirit::qi::rule<Iterator, ast::score()> start;
+  /**
+   * \brief Report why each ast::unparsable node of <code>score</code> could
+   *        not be parsed, in input order.
+   */
+  void report_unparsable(ast::score const &) const;
+
+  boost::spirit::qi::rule<Iterator, ast::score()> start, head;
+  boost::spirit::qi::rule<Iterator, section_list()> sections;
   boost::spirit::qi::rule<Iterator, ast::part()> solo_part, keyboard_part;
   boost::spirit::qi::rule<Iterator, ast::section()> keyboard_section, last_keyboard_section;
   boost::spirit::qi::rule<Iterator, ast::section()> solo_section, last_solo_section;
   boost::spirit::qi::rule<Iterator, ast::paragraph()> paragraph;
+  boost::spirit::qi::rule<Iterator, ast::paragraph_element()> paragraph_element;
+  boost::spirit::qi::rule<Iterator, ast::measure()> recoverable_measure;
+  boost::spirit::qi::rule<Iterator, ast::unparsable()> unparsable;
   boost::spirit::qi::rule<Iterator, ast::section::number_type()> section_number;
   boost::spirit::qi::rule<Iterator, ast::measure_range()> measure_range;
   boost::spirit::qi::rule<Iterator, ast::measure_specification()> measure_specification;
@@ -44,8 +65,119 @@ struct score_grammar : boost::spirit::qi::grammar<Iterator, ast::score()>
   boost::spirit::qi::rule<Iterator> right_hand_sign, left_hand_sign;
   boost::spirit::qi::rule<Iterator> eom;
   boost::spirit::qi::rule<Iterator> optional_dot, whitespace, indent;
+  boost::spirit::qi::rule<Iterator> element_end, section_start;
+
+private:
+  error_handler<Iterator> &errors;
+};
+
+/**
+ * \brief A score grammar which is built once and reused for many inputs.
+ *
+ * The grammar is not tied to any input or error handler.  Every parse
+ * records diagnostics and source ranges in the error handler passed to it,
+ * and looks text up in the braille table passed to it, so one instance can be
+ * shared by any number of threads.
+ *
+ * If the input can not be parsed, it is parsed a second time, skipping over
+ * every measure which can not be parsed up to the next whitespace or line
+ * end.  If that succeeds, the skipped input ends up in ast::unparsable
+ * nodes, all of them are reported at once, and the parse counts as
+ * successful, so that the rest of the score can still be compiled.
+ * Otherwise the errors of the first attempt are reported.
+ */
+template<typename Iterator>
+class score_parser
+{
+  error_handler<Iterator> deferred;
+
+public:
+  score_grammar<Iterator> const grammar;
+
+  score_parser() : grammar(deferred) {}
+  score_parser(score_parser const &) = delete;
+  score_parser &operator=(score_parser const &) = delete;
+
+  bool operator()( Iterator &first, Iterator last
+                 , error_handler<Iterator> &error_handler
+                 , ast::score &score
+                 , braille_table const &table = current_braille_table()
+                 ) const
+  {
+    typename braille::error_handler<Iterator>::scope const scope(error_handler);
+    braille_table::scope const table_scope(table);
+    std::size_t const messages = error_handler.messages->size();
+    Iterator const begin = first;
+    bool const parsed = boost::spirit::qi::parse(first, last, grammar, score);
+    if (parsed && first == last) return true;
+
+    std::size_t const failed_messages = error_handler.messages->size();
+    std::size_t const ranges = error_handler.ranges.size();
+    ast::score recovered;
+    Iterator iter = begin;
+    bool complete;
+    error_handler.recover = true;
+    try {
+      complete = boost::spirit::qi::parse(iter, last, grammar, recovered)
+              && iter == last;
+    } catch (...) {
+      error_handler.recover = false;
+      throw;
+    }
+    error_handler.recover = false;
+    if (!complete) {
+      error_handler.messages->resize(failed_messages);
+      error_handler.ranges.resize(ranges);
+      return parsed;
+    }
+
+    error_handler.messages->resize(messages);
+    grammar.report_unparsable(recovered);
+    score = std::move(recovered);
+    first = iter;
+    return true;
+  }
 };
 
+/**
+ * \brief Parse a score, splitting large inputs into independently parsed
+ *        runs of sections.
+ *
+ * Inputs of more than a few ten thousand characters are cut at line starts
+ * that can not possibly continue the paragraph before them.  The resulting
+ * runs of sections are parsed concurrently by up to <code>jobs</code>
+ * threads, each with its own error handler.  Their results are
+ * grouped into parts in input order, and node ids are renumbered to refer
+ * to the ranges recorded in <code>error_handler</code>.
+ *
+ * If any run fails to parse, or the runs do not add up to whole parts,
+ * the input is parsed again sequentially, so that errors are reported and
+ * recovered from just like score_parser would.
+ *
+ * Where to cut only depends on the input, never on <code>jobs</code>, so the
+ * resulting syntax tree is identical no matter how many threads were used.
+ * Node ids can however differ from those a plain score_grammar parse would
+ * assign.
+ *
+ * Text which is not Unicode braille is looked up in <code>table</code> by
+ * all threads.
+ *
+ * While the runs are being parsed, their sections are passed to
+ * <code>pipeline</code> in input order, so that they can be processed
+ * further while later runs are still being parsed.
+ *
+ * \return true if the input was parsed successfully, with <code>first</code>
+ *         advanced like it would be by boost::spirit::qi::parse.
+ */
+template<typename Iterator>
+bool parse_score( Iterator &first, Iterator last
+                , error_handler<Iterator> &
+                , ast::score &
+                , braille_table const &table = current_braille_table()
+                , unsigned jobs = std::thread::hardware_concurrency()
+                , section_pipeline const &pipeline = section_pipeline()
+                );
+
 }}
 
 #endif
@@ -0,0 +1,33 @@
+// Copyright (C) 2026  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#ifndef BMC_BRAILLE_PARSING_ITERATOR_HPP
+#define BMC_BRAILLE_PARSING_ITERATOR_HPP
+
+#include <string>
+#include <boost/regex/pending/unicode_iterator.hpp>
+
+namespace bmc { namespace braille {
+
+/**
+ * \brief Iterator decoding a UTF-8 encoded buffer on the fly.
+ *
+ * The grammars are explicitly instantiated for this iterator, so a file
+ * buffer (or any other contiguous UTF-8 text) can be parsed in place,
+ * without first converting it to a wide string.  Malformed UTF-8 makes
+ * dereferencing throw std::out_of_range.
+ */
+typedef boost::u8_to_u32_iterator<char const *, char32_t> utf8_iterator;
+
+/**
+ * \brief Iterator over a UTF-32 buffer, the other input type besides
+ *        std::wstring and UTF-8 the grammars are instantiated for.
+ */
+typedef char32_t const *utf32_iterator;
+
+}}
+
+#endif
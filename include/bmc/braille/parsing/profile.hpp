@@ -0,0 +1,150 @@
+// Copyright (C) 2026  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#ifndef BMC_BRAILLE_PARSING_PROFILE_HPP
+#define BMC_BRAILLE_PARSING_PROFILE_HPP
+
+#include "config.hpp"
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <boost/spirit/home/qi/nonterminal/debug_handler.hpp>
+#include "bmc/braille/parsing/error_handler.hpp"
+
+namespace bmc { namespace braille {
+
+/**
+ * \brief How often a grammar rule was tried, and how far it got.
+ *
+ * Counters are shared by all grammars of all iterator types, and updated by
+ * any number of parsing threads.
+ */
+struct rule_profile
+{
+  std::atomic<std::uint64_t> entered { 0 }, succeeded { 0 }, failed { 0 };
+  /**
+   * \brief Characters consumed by the profiled rules nested in this one,
+   *        summed up over all of its failed attempts.
+   */
+  std::atomic<std::uint64_t> consumed_before_failure { 0 };
+};
+
+/**
+ * \brief The counters of the rule called <code>name</code>.
+ */
+rule_profile &profiled_rule(std::string const &name);
+
+/**
+ * \brief Write a table of all profiled rules, most often entered first.
+ */
+void write_grammar_profile(std::ostream &);
+
+namespace detail {
+
+/**
+ * \brief Count attempts of a rule, see boost::spirit::qi::debug.
+ *
+ * A failing rule does not advance its iterator, so how far it got is
+ * tracked per thread: every rule which succeeds moves the furthest position
+ * of the rule it is nested in ahead.
+ */
+template <typename Iterator>
+class rule_profiler
+{
+  struct attempt
+  {
+    Iterator start, furthest;
+  };
+
+  rule_profile *profile;
+
+  static std::vector<attempt> &attempts()
+  {
+    static thread_local std::vector<attempt> stack;
+    return stack;
+  }
+
+  static void reached(std::vector<attempt> &stack, Iterator const &position)
+  {
+    if (!stack.empty()) {
+      attempt &outer = stack.back();
+      if (code_units<Iterator>::distance(outer.start, position) >
+          code_units<Iterator>::distance(outer.start, outer.furthest))
+        outer.furthest = position;
+    }
+  }
+
+public:
+  explicit rule_profiler(rule_profile &profile) : profile(&profile) {}
+
+  template <typename Context>
+  void operator()( Iterator &first, Iterator const &, Context const &
+                 , boost::spirit::qi::debug_handler_state state
+                 , std::string const &
+                 ) const
+  {
+    std::vector<attempt> &stack = attempts();
+    switch (state) {
+    case boost::spirit::qi::pre_parse:
+      profile->entered.fetch_add(1, std::memory_order_relaxed);
+      stack.push_back({first, first});
+      break;
+    case boost::spirit::qi::successful_parse:
+      profile->succeeded.fetch_add(1, std::memory_order_relaxed);
+      stack.pop_back();
+      reached(stack, first);
+      break;
+    case boost::spirit::qi::failed_parse: {
+      attempt const failed = stack.back();
+      stack.pop_back();
+      profile->failed.fetch_add(1, std::memory_order_relaxed);
+      profile->consumed_before_failure.fetch_add
+      (std::distance(failed.start, failed.furthest), std::memory_order_relaxed);
+      reached(stack, failed.furthest);
+      break;
+    }
+    }
+  }
+};
+
+}
+
+/**
+ * \brief Count how often <code>rule</code> is entered, succeeds and fails,
+ *        under <code>name</code>.
+ *
+ * Must be called after the rule has been defined.
+ */
+template <typename Rule>
+void profile(Rule &rule, std::string const &name)
+{
+  typedef typename Rule::iterator_type iterator_type;
+  boost::spirit::qi::debug
+  (rule, detail::rule_profiler<iterator_type>(profiled_rule(name)));
+}
+
+}}
+
+/**
+ * \brief Profile the rules in <code>SEQ</code> of the grammar called
+ *        <code>GRAMMAR</code>, if built with BMC_GRAMMAR_PROFILE.
+ *
+ * Otherwise this expands to nothing, leaving the rules untouched.
+ */
+#if defined(BMC_GRAMMAR_PROFILE)
+#define BMC_PROFILE_RULE(r, GRAMMAR, RULE) \
+  ::bmc::braille::profile(RULE, GRAMMAR "." BOOST_PP_STRINGIZE(RULE));
+#define BMC_PROFILE_RULES(GRAMMAR, SEQ) \
+  BOOST_PP_SEQ_FOR_EACH(BMC_PROFILE_RULE, GRAMMAR, SEQ)
+#else
+#define BMC_PROFILE_RULES(GRAMMAR, SEQ)
+#endif
+
+#endif
@@ -35,7 +35,10 @@ namespace bmc { namespace braille {
     template <typename Context, typename Iterator>
     struct attribute { typedef boost::spirit::unused_type type; };
 
-    brl_parser(Int dots) : dots(from_decimal(dots)) {}
+    brl_parser(Int dots)
+    : dots(from_decimal(dots))
+    , table(get_braille_table(default_table))
+    {}
 
     template< typename Iterator
             , typename Context, typename Skipper, typename Attribute
@@ -47,8 +50,16 @@ namespace bmc { namespace braille {
       boost::spirit::qi::skip_over(first, last, skipper);
       if (first == last) return false;
       if (*first < 0X20) return false;
-      unsigned char
-      d = get_dots_for_character(*first) & 0X3F;
+      // Input translated with braille_table::to_unicode_braille() never
+      // needs a table lookup.  Text is looked up in the table of the parse in
+      // progress, falling back to default_table as it was when this parser
+      // was built.
+      unsigned char d;
+      if ((*first & ~0XFF) == 0X2800) d = *first & 0X3F;
+      else {
+        braille_table const *scoped = braille_table::scoped();
+        d = (scoped? *scoped: table).dots(*first) & 0X3F;
+      }
       if (d == dots) {
         ++first;
         return true;
@@ -62,6 +73,7 @@ namespace bmc { namespace braille {
 
   private:
     Int const dots;
+    braille_table const &table;
 
     static Int from_decimal(Int dots, Int bits = 0)
     {
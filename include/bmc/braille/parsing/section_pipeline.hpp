@@ -0,0 +1,47 @@
+// Copyright (C) 2026  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#ifndef BMC_BRAILLE_PARSING_SECTION_PIPELINE_HPP
+#define BMC_BRAILLE_PARSING_SECTION_PIPELINE_HPP
+
+#include <functional>
+#include "bmc/braille/ast/ast.hpp"
+
+namespace bmc { namespace braille {
+
+/**
+ * \brief The rule a section of a part was recognized by.
+ *
+ * Only the last section of a part is terminated by an end-of-music sign.
+ */
+enum class section_kind { keyboard, last_keyboard, solo, last_solo };
+
+/**
+ * \brief Hooks for processing sections while the rest of a score is still
+ *        being parsed.
+ *
+ * parse_score calls <code>section</code> for every section, in input order,
+ * as soon as it and all sections before it have been parsed.  Node ids of
+ * the section already refer to the ranges of the error handler passed to
+ * parse_score, and the section stays where it is until <code>finish</code>
+ * has returned.  It is called from the thread which called parse_score,
+ * the only one touching the error handler while parsing.
+ *
+ * <code>finish</code> is called once after the last section with
+ * <code>true</code>, before all sections are moved into the score.  If the
+ * input has to be parsed again sequentially, it is instead called with
+ * <code>false</code>, and the sections seen so far are discarded.  Both
+ * hooks are only called if the input is actually split into runs.
+ */
+struct section_pipeline
+{
+  std::function<void(ast::score const &, section_kind, ast::section &)> section;
+  std::function<void(bool parsed)> finish;
+};
+
+}}
+
+#endif
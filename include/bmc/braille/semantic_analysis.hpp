@@ -8,13 +8,23 @@
 #define BMC_BRAILLE_SEMANTIC_ANALYSIS_HPP_INCLUDED
 
 #include "bmc/braille/ast.hpp"
+#include "bmc/braille/ast/visitor.hpp"
 #include "bmc/braille/semantic_analysis/location_calculator.hpp"
 #include "bmc/braille/semantic_analysis/value_disambiguator.hpp"
 #include "bmc/braille/semantic_analysis/octave_calculator.hpp"
 #include "bmc/braille/semantic_analysis/alteration_calculator.hpp"
 #include "bmc/braille/semantic_analysis/doubling_decoder.hpp"
+#include "bmc/braille/parsing/section_pipeline.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <boost/optional.hpp>
 
 namespace bmc { namespace braille {
 
@@ -23,7 +33,15 @@ enum class sign_conversion_result
   ok, full_measure_simile, failed
 };
 
-class sign_converter: public boost::static_visitor<sign_conversion_result>
+/**
+ * \brief Append a single sign of a partial voice to its unfolded counterpart.
+ *
+ * With <code>Ref</code> set to ast::make_const_ref the source signs are
+ * copied.  With ast::make_ref they are moved out of the raw AST, which
+ * is left in a valid but unspecified state.
+ */
+template <template <typename> class Ref>
+class basic_sign_converter: public boost::static_visitor<sign_conversion_result>
 {
   ast::unfolded::partial_voice &target;
   std::size_t const voice_index, voice_count
@@ -33,12 +51,12 @@ class sign_converter: public boost::static_visitor<sign_conversion_result>
   ast::unfolded::measure *prev_unfolded_measure;
   std::size_t simile_start = 0;
 public:
-  sign_converter( ast::unfolded::partial_voice &target
-                , std::size_t voice_index, std::size_t voice_count
-                , std::size_t partial_measure_index
-                , std::size_t partial_voice_index
-                , ast::unfolded::measure *prev_unfolded_measure
-                )
+  basic_sign_converter( ast::unfolded::partial_voice &target
+                      , std::size_t voice_index, std::size_t voice_count
+                      , std::size_t partial_measure_index
+                      , std::size_t partial_voice_index
+                      , ast::unfolded::measure *prev_unfolded_measure
+                      )
   : target{target}
   , voice_index(voice_index)
   , voice_count(voice_count)
@@ -48,14 +66,14 @@ public:
   {}
 
   // Value distinction signs, music hyphens and tuplet indicators are irrelevant from here on.
-  result_type operator() (ast::value_prefix const &) const
+  result_type operator() (Ref<ast::value_prefix>) const
   { return sign_conversion_result::ok; }
-  result_type operator() (ast::hyphen const &) const
+  result_type operator() (Ref<ast::hyphen>) const
   { return sign_conversion_result::ok; }
-  result_type operator() (ast::tuplet_start const &) const
+  result_type operator() (Ref<ast::tuplet_start>) const
   { return sign_conversion_result::ok; }
 
-  result_type operator() (ast::simile const &simile)
+  result_type operator() (Ref<ast::simile> simile)
   {
     if (!duration(target)) {
       if (prev_unfolded_measure) {
@@ -68,60 +86,76 @@ public:
                      , prev_unfolded_measure->voices[voice_index][partial_measure_index][partial_voice_index].end());
       }
     } else {
-      ast::unfolded::partial_voice repeated {
-        std::next(target.begin(), simile_start), target.end()
-      };
-      if (duration(repeated) == (simile.duration / rational::int_type(simile.count))) {
+      auto const repeated_begin = std::next(target.begin(), simile_start);
+      if (std::accumulate(repeated_begin, target.end(), rational()) ==
+          (simile.duration / rational::int_type(simile.count))) {
+        // Repeat the signs in place, the reserve guarantees that no
+        // reallocation invalidates the source range while appending.
+        std::size_t const length = target.size() - simile_start;
+        target.reserve(target.size() + length * simile.count);
         for (unsigned i = 0; i < simile.count; ++i)
-          target.insert(target.end(), repeated.begin(), repeated.end());
+          std::copy_n( std::next(target.begin(), simile_start), length
+                     , std::back_inserter(target));
         simile_start = target.size();
       }
     }
     return sign_conversion_result::ok;
   }
 
+  // Moves if T is non-const, copies otherwise.
   template<typename T>
-  result_type operator() (T const &t) const
+  result_type operator() (T &t) const
   {
-    target.emplace_back(t);
+    target.emplace_back(std::move(t));
     return sign_conversion_result::ok;
   }
 };
 
-class staff_converter: public boost::static_visitor<bool>
+using sign_converter = basic_sign_converter<ast::make_const_ref>;
+
+/**
+ * \brief Convert a paragraph of measures to an unfolded staff.
+ *
+ * \see basic_sign_converter
+ */
+template <template <typename> class Ref>
+class basic_staff_converter: public boost::static_visitor<bool>
 {
   ast::unfolded::staff &target;
   ast::unfolded::measure *prev_unfolded_measure;
 public:
-  staff_converter( ast::unfolded::staff &target )
+  basic_staff_converter( ast::unfolded::staff &target )
   : target(target)
   , prev_unfolded_measure(nullptr)
   {}
 
-  result_type operator() (ast::measure const &measure)
+  result_type operator() (Ref<ast::measure> measure)
   {
     ast::unfolded::measure unfolded_measure;
     unfolded_measure.ending = measure.ending;
     bool insert = true;
-    for (ast::voice const &voice: measure.voices) {
+    for (auto &voice: measure.voices) {
       std::size_t voice_index = unfolded_measure.voices.size();
       unfolded_measure.voices.emplace_back();
       ast::unfolded::voice &new_voice = unfolded_measure.voices.back();
-      for (ast::partial_measure const &partial_measure: voice) {
+      new_voice.reserve(voice.size());
+      for (auto &partial_measure: voice) {
         std::size_t const partial_measure_index = new_voice.size();
         new_voice.emplace_back();
         ast::unfolded::partial_measure &new_partial_measure = new_voice.back();
-        for (ast::partial_voice const &partial_voice: partial_measure) {
+        new_partial_measure.reserve(partial_measure.size());
+        for (auto &partial_voice: partial_measure) {
           std::size_t const partial_voice_index = new_partial_measure.size();
           new_partial_measure.emplace_back();
-          sign_converter unfold( new_partial_measure.back()
-                               , voice_index, measure.voices.size()
-                               , partial_measure_index
-                               , partial_voice_index
-                               , prev_unfolded_measure
-                               );
-          for (ast::partial_voice::const_iterator sign = partial_voice.begin();
-               sign != partial_voice.end(); ++sign) {
+          new_partial_measure.back().reserve(partial_voice.size());
+          basic_sign_converter<Ref> unfold( new_partial_measure.back()
+                                          , voice_index, measure.voices.size()
+                                          , partial_measure_index
+                                          , partial_voice_index
+                                          , prev_unfolded_measure
+                                          );
+          for (auto sign = partial_voice.begin(); sign != partial_voice.end();
+               ++sign) {
             switch (apply_visitor(unfold, *sign)) {
             case sign_conversion_result::failed: return false;
             case sign_conversion_result::full_measure_simile:
@@ -137,18 +171,22 @@ public:
       }
     }
     if (insert) {
-      target.emplace_back(unfolded_measure);
+      ast::cache_durations(unfolded_measure);
+      target.emplace_back(std::move(unfolded_measure));
       prev_unfolded_measure = boost::get<ast::unfolded::measure>(&target.back());
     }
     return true;
   }
-  result_type operator() (ast::key_and_time_signature const &key_and_time_signature) const
+  result_type operator() (Ref<ast::key_and_time_signature> key_and_time_signature) const
   {
-    target.emplace_back(key_and_time_signature);
+    target.emplace_back(std::move(key_and_time_signature));
     return true;
   }
+  result_type operator() (Ref<ast::unparsable>) const { return false; }
 };
 
+using staff_converter = basic_staff_converter<ast::make_const_ref>;
+
 template <typename ErrorHandler>
 class annotate_staff : public compiler_pass, public boost::static_visitor<bool>
 {
@@ -158,6 +196,7 @@ class annotate_staff : public compiler_pass, public boost::static_visitor<bool>
   alteration_calculator calculate_alterations;
   ::bmc::time_signature global_time_signature;
   ::bmc::key_signature global_key_signature;
+  bool locate = true;
 
 public:
   annotate_staff( ErrorHandler &error_handler
@@ -175,7 +214,27 @@ public:
   {
   }
 
+  /**
+   * \brief Leave source locations alone, for callers which calculate them
+   *        on their own.
+   */
+  void skip_locations() { locate = false; }
+
   result_type operator() (std::size_t staff_index, ast::part &part)
+  {
+    start_staff(staff_index);
+    for (ast::section &section: part) {
+      if (!annotate(section.paragraphs[staff_index])) return false;
+    }
+
+    return end_of_staff();
+  }
+
+  /**
+   * \brief Prepare for annotating the paragraphs of staff
+   *        <code>staff_index</code> of a part, one after another.
+   */
+  void start_staff(std::size_t staff_index)
   {
     interval_direction interval_dir = interval_direction::down;
     switch (staff_index) {
@@ -192,23 +251,23 @@ public:
     calculate_octaves.set(interval_dir);
     disambiguate_values.set(global_time_signature);
     calculate_alterations.set(global_key_signature);
+  }
 
-    for (ast::section &section: part) {
-      ast::paragraph &paragraph = section.paragraphs[staff_index];
-      if (!std::all_of( std::begin(paragraph), std::end(paragraph)
-	              , apply_visitor(*this)))
-	return false;
-    }
-
-    return disambiguate_values.end_of_staff();
+  result_type annotate(ast::paragraph &paragraph)
+  {
+    return std::all_of( std::begin(paragraph), std::end(paragraph)
+                      , apply_visitor(*this));
   }
 
+  result_type end_of_staff() const
+  { return disambiguate_values.end_of_staff(); }
+
   result_type operator()(ast::measure& measure)
   {
     if (calculate_octaves(measure)) {
       if (disambiguate_values(measure))
         calculate_alterations(measure);
-        calculate_locations(measure);
+        if (locate) calculate_locations(measure);
         return true;
       }
     return false;
@@ -216,11 +275,165 @@ public:
 
   result_type operator()(ast::key_and_time_signature &key_and_time_sig)
   {
-    calculate_locations(key_and_time_sig);
+    if (locate) calculate_locations(key_and_time_sig);
     disambiguate_values.set(key_and_time_sig.time);
     calculate_alterations.set(key_and_time_sig.key);
     return true;
   }
+
+  // The parse error has already been reported, the rest of this staff can
+  // not be interpreted without the measure that is missing.
+  result_type operator()(ast::unparsable &) { return false; }
+};
+
+/**
+ * \brief Annotate the sections of a score while it is still being parsed.
+ *
+ * Sections are handed over by parse_score in input order (see
+ * section_pipeline).  Source locations are calculated right away, on the
+ * parsing thread, which is the only one touching the error handler until
+ * parsing has finished.  Everything else is done by one worker thread per
+ * staff, which carries time signature, key signature and anacrusis from one
+ * section of a part to the next, exactly like annotate_staff does for a
+ * whole part.  Errors found by the workers are reported once all of them
+ * have finished.
+ *
+ * \ingroup compilation
+ */
+template <typename ErrorHandler>
+class section_annotator
+{
+  typedef std::function<void(int tag, std::wstring const& what)> report_error_type;
+
+  struct paragraph_item
+  {
+    ast::paragraph *paragraph;
+    bool starts_part;
+    ::bmc::time_signature time_signature;
+    ::bmc::key_signature key_signature;
+  };
+
+  ErrorHandler &error_handler;
+  report_error_type const report_error;
+  ::bmc::time_signature const default_time_signature;
+  location_calculator<ErrorHandler> calculate_locations;
+  bool in_part = false;
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  bool closed = false;
+  std::vector<std::deque<paragraph_item>> staves;
+  std::vector<std::future<bool>> workers;
+  std::vector<std::pair<int, std::wstring>> errors;
+
+  bool annotate_paragraphs(std::size_t staff_index)
+  {
+    report_error_type const defer = [this](int tag, std::wstring const &what) {
+      std::lock_guard<std::mutex> lock(mutex);
+      errors.emplace_back(tag, what);
+    };
+    std::unique_ptr<annotate_staff<ErrorHandler>> staff;
+    bool ok = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      ready.wait(lock, [&]() { return closed || !staves[staff_index].empty(); });
+      if (staves[staff_index].empty()) break;
+      paragraph_item const item = staves[staff_index].front();
+      staves[staff_index].pop_front();
+      lock.unlock();
+
+      // After a failure, the remaining paragraphs are merely drained.
+      if (ok && item.starts_part) {
+        ok = !staff || staff->end_of_staff();
+        staff.reset(new annotate_staff<ErrorHandler>( error_handler, defer
+                                                    , item.time_signature
+                                                    , item.key_signature
+                                                    ));
+        staff->skip_locations();
+        staff->start_staff(staff_index);
+      }
+      if (ok) ok = staff->annotate(*item.paragraph);
+
+      lock.lock();
+    }
+    lock.unlock();
+    return ok && (!staff || staff->end_of_staff());
+  }
+
+public:
+  section_annotator( ErrorHandler &error_handler
+                   , report_error_type const &report_error
+                   , ::bmc::time_signature const &time_signature
+                   )
+  : error_handler(error_handler)
+  , report_error(report_error)
+  , default_time_signature(time_signature)
+  , calculate_locations(report_error, error_handler)
+  {}
+
+  ~section_annotator() { finish(false); }
+
+  void operator()(ast::score const &score, section_kind kind,
+                  ast::section &section)
+  {
+    for (ast::paragraph &paragraph: section.paragraphs) {
+      for (ast::paragraph_element &element: paragraph) {
+        if (ast::measure *measure = boost::get<ast::measure>(&element))
+          calculate_locations(*measure);
+        else if (ast::key_and_time_signature *key_and_time_sig =
+                 boost::get<ast::key_and_time_signature>(&element))
+          calculate_locations(*key_and_time_sig);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (std::size_t staff_index = 0; staff_index < section.paragraphs.size();
+           ++staff_index) {
+        if (staff_index == staves.size()) {
+          staves.emplace_back();
+          workers.push_back(std::async( std::launch::async
+                                      , &section_annotator::annotate_paragraphs
+                                      , this
+                                      , staff_index));
+        }
+        staves[staff_index].push_back
+        ({ &section.paragraphs[staff_index], !in_part
+         , score.time_sigs.empty()? default_time_signature
+                                  : score.time_sigs.front()
+         , score.key_sig
+         });
+      }
+    }
+    ready.notify_all();
+    in_part = kind != section_kind::last_keyboard &&
+              kind != section_kind::last_solo;
+  }
+
+  /**
+   * \brief Wait for all sections to be annotated.
+   *
+   * Errors are only reported if <code>parsed</code> is true, otherwise the
+   * sections they refer to are about to be discarded.
+   *
+   * \return true if all staves were annotated successfully.
+   */
+  bool finish(bool parsed)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closed = true;
+    }
+    ready.notify_all();
+    bool ok = true;
+    for (auto &worker: workers) ok = worker.get() && ok;
+    workers.clear();
+    if (parsed) {
+      for (auto const &error: errors) report_error(error.first, error.second);
+    }
+    errors.clear();
+    return ok;
+  }
 };
 
 /**
@@ -239,25 +452,35 @@ public:
  * in a measure along the time axis to correctly interpret accidental markings,
  * therefore it depends on value disambiguation already having taken place.
  *
+ * Finally, the raw syntax tree is unfolded into score::unfolded_part.
+ * If the raw syntax tree is not needed anymore (it is only used by the
+ * braille reformatter) discard_source_tree() can be used to release it
+ * as soon as it has been unfolded, which considerably lowers peak memory usage
+ * for large scores.
+ *
  * \ingroup compilation
  * \todo Expand simile signs (unrolling)
  */
 template <typename ErrorHandler>
 class compiler : public compiler_pass, public boost::static_visitor<bool>
 {
-  ErrorHandler error_handler;
+  ErrorHandler &error_handler;
   location_calculator<ErrorHandler> calculate_locations;
   octave_calculator calculate_octaves;
   value_disambiguator disambiguate_values;
   alteration_calculator calculate_alterations;
   ::bmc::time_signature global_time_signature;
+  bool keep_source_tree = true;
+  std::unique_ptr<section_annotator<ErrorHandler>> annotator;
+  // Whether the score was annotated successfully while being parsed.
+  boost::optional<bool> annotated;
 
 public:
   compiler( ErrorHandler& error_handler
           , ::bmc::time_signature const& time_signature = ::bmc::time_signature(4, 4)
           )
   : compiler_pass( [&error_handler](int tag, std::wstring const &what)
-                   { error_handler(L"Error", what, error_handler.ranges[tag].begin()); }
+                   { error_handler(L"Error", what, error_handler.range(tag).begin()); }
                  )
   , error_handler(error_handler)
   , calculate_locations(report_error, error_handler)
@@ -268,11 +491,55 @@ public:
   {
   }
 
+  /**
+   * \brief Release score::parts and the source ranges of the error handler
+   *        once the score has been unfolded.
+   *
+   * Only LilyPond and MusicXML output can be generated from the compiled score
+   * afterwards, the braille reformatter needs the raw syntax tree.
+   */
+  void discard_source_tree(bool discard = true)
+  { keep_source_tree = !discard; }
+
+  /**
+   * \brief Hooks for parse_score which annotate sections while later ones
+   *        are still being parsed.
+   *
+   * If parse_score makes use of them, the next call to operator() only
+   * unfolds the score.  The hooks refer to this compiler, which has to
+   * outlive the call to parse_score they are passed to.
+   *
+   * \see section_annotator
+   */
+  section_pipeline pipeline()
+  {
+    return {
+      [this](ast::score const &score, section_kind kind, ast::section &section) {
+        if (!annotator) {
+          annotator.reset(new section_annotator<ErrorHandler>
+                          (error_handler, report_error, global_time_signature));
+        }
+        (*annotator)(score, kind, section);
+      },
+      [this](bool parsed) {
+        if (annotator) {
+          bool const ok = annotator->finish(parsed);
+          annotator.reset();
+          if (parsed) annotated = ok;
+        }
+      }
+    };
+  }
+
   result_type operator()(ast::score& score)
   {
     if (!score.time_sigs.empty()) global_time_signature = score.time_sigs.front();
 
-    {
+    if (annotated) {
+      bool const ok = *annotated;
+      annotated = boost::none;
+      if (!ok) return false;
+    } else {
       std::vector<std::future<bool>> staves;
       for (ast::part &part: score.parts) {
         if (!part.empty()) {
@@ -296,7 +563,13 @@ public:
         return false;
     }
 
-    return unfold(score);
+    if (keep_source_tree) return unfold(score);
+
+    if (!unfold_destructively(score)) return false;
+    score.parts.clear();
+    score.parts.shrink_to_fit();
+    error_handler.release_ranges();
+    return true;
   }
 
   result_type unfold (ast::score &score)
@@ -307,9 +580,71 @@ public:
     }
     return true;
   }
+
+  /**
+   * \brief Unfold <code>score.parts</code> by moving signs instead of copying.
+   *
+   * Only signs repeated by a simile are copied.  Each paragraph is released
+   * as soon as it has been unfolded.  Afterwards <code>score.parts</code>
+   * no longer holds any signs and must not be passed to the reformatter.
+   */
+  result_type unfold_destructively (ast::score &score)
+  {
+    for (ast::part &part: score.parts) {
+      score.unfolded_part.emplace_back();
+      if (!unfold(std::move(part), score.unfolded_part.back())) return false;
+    }
+    return true;
+  }
+
   result_type unfold ( ast::part const &source
                      , ast::unfolded::part &target
                      )
+  {
+    return unfold_part<ast::make_const_ref>(source, target);
+  }
+  result_type unfold ( ast::part &&source
+                     , ast::unfolded::part &target
+                     )
+  {
+    return unfold_part<ast::make_ref>(source, target);
+  }
+  result_type unfold ( ast::paragraph const &source
+                     , ast::unfolded::staff &target
+                     )
+  {
+    return unfold_paragraph<ast::make_const_ref>(source, target);
+  }
+  result_type unfold ( ast::paragraph &&source
+                     , ast::unfolded::staff &target
+                     )
+  {
+    return unfold_paragraph<ast::make_ref>(source, target);
+  }
+
+  result_type operator()(ast::measure& measure)
+  {
+    disambiguate_values.set(global_time_signature);
+    if (disambiguate_values(measure))
+      if (calculate_octaves(measure)) {
+        calculate_alterations(measure);
+        calculate_locations(measure);
+        return true;
+      }
+    return false;
+  }
+  result_type operator()(ast::key_and_time_signature& key_and_time_sig)
+  {
+    calculate_locations(key_and_time_sig);
+    disambiguate_values.set(key_and_time_sig.time);
+    return true;
+  }
+
+private:
+  template <template <typename> class Ref>
+  result_type unfold_part ( Ref<ast::part> source
+                          , ast::unfolded::part &target
+                          )
   {
     BOOST_ASSERT(!source.empty());
     size_t const staves{source.front().paragraphs.size()};
@@ -318,10 +653,11 @@ public:
                                return section.paragraphs.size() == staves;
                              }));
     for (unsigned int i = 0; i < staves; ++i) target.emplace_back();
-    for (ast::section const &section: source) {
+    for (auto &section: source) {
       int i = 0;
-      for (ast::paragraph const &paragraph: section.paragraphs) {
-        if (!unfold(paragraph, target.at(i++))) return false;
+      for (auto &paragraph: section.paragraphs) {
+        if (!unfold_paragraph<Ref>(paragraph, target.at(i++))) return false;
+        release(paragraph);
       }
     }
 
@@ -335,30 +671,19 @@ public:
 
     return true;
   }
-  result_type unfold ( ast::paragraph const &source
-                     , ast::unfolded::staff &target
-                     )
+  template <template <typename> class Ref>
+  result_type unfold_paragraph ( Ref<ast::paragraph> source
+                               , ast::unfolded::staff &target
+                               )
   {
-    staff_converter unfold(target);
+    basic_staff_converter<Ref> unfold(target);
     return std::all_of(source.begin(), source.end(), apply_visitor(unfold));
   }
-
-  result_type operator()(ast::measure& measure)
+  static void release(ast::paragraph const &) {}
+  static void release(ast::paragraph &paragraph)
   {
-    disambiguate_values.set(global_time_signature);
-    if (disambiguate_values(measure))
-      if (calculate_octaves(measure)) {
-        calculate_alterations(measure);
-        calculate_locations(measure);
-        return true;
-      }
-    return false;
-  }
-  result_type operator()(ast::key_and_time_signature& key_and_time_sig)
-  {
-    calculate_locations(key_and_time_sig);
-    disambiguate_values.set(key_and_time_sig.time);
-    return true;
+    paragraph.clear();
+    paragraph.shrink_to_fit();
   }
 };
 
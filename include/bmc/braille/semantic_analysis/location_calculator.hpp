@@ -47,12 +47,12 @@ public:
   bool visit_locatable(ast::locatable& lexeme) {
     typedef typename ErrorHandler::iterator_type iterator_type;
     if (lexeme.id >= 0) {
-      BOOST_ASSERT(lexeme.id < handler.ranges.size());
-      iterator_type const begin_line_start(handler.get_pos(handler.ranges[lexeme.id].begin(), lexeme.begin_line));
-      lexeme.begin_column = std::distance(begin_line_start, handler.ranges[lexeme.id].begin()) + 1;
+      auto const range = handler.range(lexeme.id);
+      iterator_type const begin_line_start(handler.get_pos(range.begin(), lexeme.begin_line));
+      lexeme.begin_column = std::distance(begin_line_start, range.begin()) + 1;
 
-      iterator_type const end_line_start(handler.get_pos(handler.ranges[lexeme.id].end(), lexeme.end_line));
-      lexeme.end_column = std::distance(end_line_start, handler.ranges[lexeme.id].end()) + 1;
+      iterator_type const end_line_start(handler.get_pos(range.end(), lexeme.end_line));
+      lexeme.end_column = std::distance(end_line_start, range.end()) + 1;
     }
 
     return true;
@@ -40,6 +40,9 @@ namespace bmc { namespace braille {
  * two measures are combined, and if they add up to a duration which equals  to
  * the current time signature, both measures are disambiguated correctly.
  *
+ * Once the values of a measure are accepted, its durations are cached in the
+ * syntax tree (see ast::duration_cache).
+ *
  * \ingroup compilation
  */
 class value_disambiguator: public compiler_pass
@@ -48,6 +51,7 @@ class value_disambiguator: public compiler_pass
   rational prev_duration;
   value_disambiguation::measure_doubled_tuplet_info prev_doubled_tuplets;
   boost::optional<value_disambiguation::measure_interpretations> anacrusis;
+  ast::measure *anacrusis_measure = nullptr;
 
 public:
   typedef bool result_type;
@@ -3,12 +3,118 @@
 
 #include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace bmc { namespace braille {
 
 extern std::string default_table;
 
 void set_default_table_from_locale ();
+
+/** \brief A braille text table compiled for constant time lookups.
+ *
+ * Characters of the Basic Multilingual Plane are looked up in a directly
+ * indexed array, everything else in a small hash table.  Aliases are
+ * resolved when the table is built, and Unicode braille patterns always map
+ * to themselves.
+ *
+ * Tables are obtained with get_braille_table(), which builds each of them
+ * only once and returns a reference that stays valid for the lifetime of
+ * the program.
+ */
+class braille_table
+{
+  static constexpr std::uint16_t unmapped = 0X100;
+  std::vector<std::uint16_t> bmp;
+  std::unordered_map<char32_t, std::uint8_t> others;
+
+  [[noreturn]] static void no_mapping();
+
+  std::uint16_t find(char32_t c) const
+  {
+    if (c < bmp.size()) return bmp[c];
+    auto const i = others.find(c);
+    return i != others.end()? i->second: unmapped;
+  }
+
+public:
+  braille_table( std::pair<char32_t, std::uint8_t> const *mapping_begin
+               , std::pair<char32_t, std::uint8_t> const *mapping_end
+               , std::pair<char32_t, char32_t> const *aliases_begin
+               , std::pair<char32_t, char32_t> const *aliases_end
+               );
+
+  /** \brief Dots of the braille cell character <code>c</code> represents.
+   *
+   * \throw std::runtime_error if <code>c</code> is not part of the table.
+   */
+  std::uint8_t dots(char32_t c) const
+  {
+    std::uint16_t const d = find(c);
+    if (d == unmapped) no_mapping();
+    return d;
+  }
+
+  /** \brief Translate text to Unicode braille in place.
+   *
+   * Every character the table knows about is replaced by the Unicode
+   * braille pattern it represents, so that the parser only ever sees braille
+   * and never has to consult a text table again.  Control characters (like
+   * line breaks) and characters without a mapping are left alone, the
+   * latter still make the parser fail where they occur.  Since the text is
+   * translated character by character, positions in the translated text are
+   * identical to positions in the original.
+   */
+  template <typename Char>
+  void to_unicode_braille(std::basic_string<Char> &text) const
+  {
+    for (Char &c: text) {
+      if (c >= 0X20) {
+        std::uint16_t const d = find(c);
+        if (d != unmapped) c = 0X2800 | d;
+      }
+    }
+  }
+
+  /** \brief Parse text with a particular table on the calling thread.
+   *
+   * While a scope is alive, the braille parsers look characters up in its
+   * table instead of the one named by default_table.  Scopes nest, and every
+   * thread has its own, so concurrent parses can each use a different table.
+   */
+  class scope
+  {
+    braille_table const *previous;
+
+  public:
+    explicit scope(braille_table const &table);
+    ~scope();
+    scope(scope const &) = delete;
+    scope &operator=(scope const &) = delete;
+  };
+
+  /** \brief The table of the innermost scope on the calling thread.
+   *
+   * \return nullptr if no scope is alive on the calling thread.
+   */
+  static braille_table const *scoped();
+};
+
+/** \brief Look up a compiled braille table by name.
+ *
+ * \throw std::runtime_error if there is no table called <code>name</code>.
+ */
+braille_table const &get_braille_table(std::string const &name);
+
+/** \brief The table text is parsed with on the calling thread.
+ *
+ * This is the table of the innermost braille_table::scope, or the one named
+ * by default_table outside of any scope.
+ */
+braille_table const &current_braille_table();
+
 uint8_t get_dots_for_character(char32_t c, std::string const &table = default_table);
 
 }}
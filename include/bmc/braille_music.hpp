@@ -7,8 +7,9 @@
 #ifndef BMC_BRAILLE_MUSIC_HPP
 #define BMC_BRAILLE_MUSIC_HPP
 
+#include <boost/container/small_vector.hpp>
 #include <boost/variant/variant.hpp>
-#include <vector>
+#include <utility>
 
 namespace bmc { namespace braille {
 
@@ -19,7 +20,9 @@ enum class interval_direction
 
 typedef std::pair<unsigned, unsigned> finger_change;
 typedef boost::variant<unsigned, finger_change> fingering;
-typedef std::vector<fingering> fingering_list;
+// Notes rarely carry more than one finger or finger change, store those
+// in place instead of allocating a vector for every fingered note.
+typedef boost::container::small_vector<fingering, 2> fingering_list;
 
 }}
 
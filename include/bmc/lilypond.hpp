@@ -8,6 +8,7 @@
 #define BMC_LILYPOND_HPP_INCLUDED
 
 #include "bmc/braille/ast.hpp"
+#include "bmc/output_buffer.hpp"
 #include "bmc/output_format.hpp"
 
 namespace bmc { namespace lilypond {
@@ -19,7 +20,11 @@ extern std::string instruments[128];
  */
 class generator: public boost::static_visitor<void>
 {
-  std::ostream& os;
+  /**
+   * \brief Generated source code, written to the stream passed to the
+   *        constructor when a score is complete.
+   */
+  mutable output_buffer out;
   bool const layout, midi, include_locations;
   std::string default_instrument;
   bool no_tagline = false;
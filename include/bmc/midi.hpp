@@ -0,0 +1,128 @@
+// Copyright (C) 2011  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#ifndef BMC_MIDI_HPP_INCLUDED
+#define BMC_MIDI_HPP_INCLUDED
+
+#include "bmc/braille/ast.hpp"
+#include "bmc/music.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bmc { namespace midi {
+
+/**
+ * \brief A sounding note, timed in whole notes from the start of the score.
+ */
+struct note
+{
+  rational begin, duration;
+  int channel, key, velocity;
+};
+
+/**
+ * \brief A note on or note off message at an integral tick.
+ *
+ * Events are packed into eight bytes, so that the events of a whole score
+ * can be kept in a vector and sorted once.
+ */
+struct event
+{
+  std::uint32_t tick;
+  std::uint8_t status, key, velocity;
+
+  bool note_on() const { return (status & 0XF0) == 0X90; }
+  int channel() const { return status & 0X0F; }
+};
+
+/**
+ * \brief Order events by time.
+ *
+ * At the same tick, note off events are placed before note on events to
+ * avoid accidentally killing a note that just started at the same time.
+ */
+inline bool operator<(event const &lhs, event const &rhs)
+{
+  return lhs.tick < rhs.tick ||
+         (lhs.tick == rhs.tick && (lhs.status & 0XF0) < (rhs.status & 0XF0));
+}
+
+/**
+ * \brief The notes of all staves of a score, with repeats played out.
+ */
+class performance
+{
+public:
+  struct staff
+  {
+    int channel;
+    std::vector<note> notes;
+    rational end;
+  };
+
+  std::vector<staff> staves;
+
+  /**
+   * \brief Key and time signature changes of the first staff, with the
+   *        time at which they occur.
+   */
+  std::vector<std::pair<rational, braille::ast::key_and_time_signature const *>>
+  signatures;
+
+  explicit performance(braille::ast::score const &, int velocity = 90);
+
+  /**
+   * \brief Returns the number of ticks per quarter note needed to express
+   *        the time of every note and signature change as an integer.
+   */
+  rational::int_type ppq() const;
+};
+
+/** \brief Convert a time in whole notes to ticks. */
+std::uint32_t ticks(rational const &, rational::int_type ppq);
+
+/**
+ * \brief Returns the note on and note off events of a staff, ordered by
+ *        time.
+ */
+std::vector<event> events(performance::staff const &, rational::int_type ppq);
+
+/**
+ * \brief Merge the ordered events of several staves into a single ordered
+ *        sequence.
+ *
+ * The merge is stable: of two events at the same tick and of the same kind,
+ * the one from the earlier staff comes first.
+ */
+std::vector<event> merge(std::vector<std::vector<event>> const &);
+
+/**
+ * \brief Look up the General MIDI program of a LilyPond instrument name.
+ *
+ * Returns 0 (acoustic grand) for unknown instruments.
+ */
+int program(std::string const &instrument);
+
+/**
+ * \brief Write a (compiled) braille score as a Standard MIDI File.
+ *
+ * The file has format 1: a conductor track with tempo, key and time
+ * signatures comes first, followed by one track per staff.  Repeats and
+ * their alternative endings are played out.  Every part is played on a
+ * channel of its own, using the given General MIDI program.
+ */
+void standard_midi_file( std::ostream &
+                       , braille::ast::score const &
+                       , int program = 0
+                       , unsigned beats_per_minute = 60
+                       );
+
+}}
+
+#endif
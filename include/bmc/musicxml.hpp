@@ -13,8 +13,34 @@
 
 namespace bmc {
 
+/**
+ * \brief Write a (compiled) braille score as a MusicXML score-partwise
+ *        document.
+ *
+ * Elements are written to the stream as they are generated, no document
+ * tree is built.
+ */
 void musicxml(std::ostream &, braille::ast::score const &);
 
+/**
+ * \brief Write the document of musicxml() as a compressed MusicXML (.mxl)
+ *        archive.
+ *
+ * The score is deflated while it is being generated, the uncompressed
+ * document is never kept in memory.  The stream does not need to be
+ * seekable, but should be opened in binary mode.
+ */
+void compressed_musicxml(std::ostream &, braille::ast::score const &);
+
+/**
+ * \brief Write the same document as musicxml(), by building and serializing
+ *        the XSD object model of MusicXML.
+ *
+ * The object model only allows elements and values the schema permits,
+ * which makes this slower variant useful for checking the streaming writer.
+ */
+void musicxml_via_xsd(std::ostream &, braille::ast::score const &);
+
 }
 
 #endif
@@ -0,0 +1,87 @@
+// Copyright (C) 2026  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#ifndef BMC_OUTPUT_BUFFER_HPP
+#define BMC_OUTPUT_BUFFER_HPP
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include "bmc/music.hpp"
+
+namespace bmc {
+
+/**
+ * \brief Collect generated text, and write it to a stream in large blocks.
+ *
+ * Integers and rationals are formatted directly into the buffer, so the
+ * locale of the target stream is never consulted.  Nothing is written
+ * before the buffer is full, flush() is called, or it is destroyed.
+ */
+class output_buffer
+{
+  std::ostream &os;
+  std::string buffer;
+
+  static std::size_t const block_size = 64 * 1024;
+
+  output_buffer &written()
+  {
+    if (buffer.size() >= block_size) flush();
+    return *this;
+  }
+
+public:
+  explicit output_buffer(std::ostream &os) : os(os)
+  { buffer.reserve(block_size + 256); }
+  output_buffer(output_buffer const &) = delete;
+  output_buffer &operator=(output_buffer const &) = delete;
+  ~output_buffer() { flush(); }
+
+  void flush()
+  {
+    if (!buffer.empty()) {
+      os.write(buffer.data(), buffer.size());
+      buffer.clear();
+    }
+  }
+
+  output_buffer &operator<<(char c)
+  { buffer += c; return written(); }
+  output_buffer &operator<<(char const *s)
+  { buffer += s; return written(); }
+  output_buffer &operator<<(std::string const &s)
+  { buffer += s; return written(); }
+
+  template<typename Integer>
+  typename std::enable_if<std::is_integral<Integer>::value, output_buffer &>::type
+  operator<<(Integer value)
+  {
+    typedef typename std::make_unsigned<Integer>::type unsigned_type;
+    char digits[3 * sizeof(Integer) + 1];
+    char *first = digits + sizeof(digits);
+    unsigned_type magnitude = value < 0? unsigned_type(0) - unsigned_type(value)
+                                       : unsigned_type(value);
+    do *--first = char('0' + magnitude % 10); while (magnitude /= 10);
+    if (value < 0) *--first = '-';
+    buffer.append(first, digits + sizeof(digits));
+    return written();
+  }
+
+  output_buffer &operator<<(rational const &value)
+  { return *this << value.numerator() << '/' << value.denominator(); }
+  output_buffer &operator<<(time_signature const &signature)
+  { return *this << signature.numerator() << '/' << signature.denominator(); }
+
+  /** \brief Append <code>count</code> copies of <code>c</code>. */
+  output_buffer &fill(std::size_t count, char c)
+  { buffer.append(count, c); return written(); }
+};
+
+}
+
+#endif
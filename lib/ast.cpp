@@ -1,12 +0,0 @@
-#include <bmc/braille/ast/ast.hpp>
-
-namespace bmc { namespace braille { namespace ast {
-
-rhythmic::~rhythmic() = default;
-note::~note() = default;
-rest::~rest() = default;
-stem::~stem() = default;
-chord::~chord() = default;
-moving_note::~moving_note() = default;
-
-}}}
@@ -8,24 +8,138 @@
 #define BMC_BRLSYM_HPP
 
 #include "config.hpp"
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
 #include <boost/spirit/include/qi_symbols.hpp>
 #include <bmc/braille/ast/ast.hpp>
 #include <bmc/braille/text2braille.hpp>
 
 namespace bmc { namespace braille {
 
-// A special version of qi::symbols<> which transparently translates its input
-// to Unicode braille.
+// A filter which transparently translates input to Unicode braille.
+// qi::symbols<> constructs a fresh filter for every lookup, so the braille
+// table is resolved once per lookup instead of once per character.  It is
+// the table of the parse in progress on the calling thread (see
+// braille_table::scope), or default_table if there is none.
+
+struct braillify {
+  braille_table const &table = current_braille_table();
 
-struct tst_braillify {
   template <typename Char>
   Char operator()(Char ch) const {
-    return ch < 0X20? ch: 0X2800 | (get_dots_for_character(ch)&0X3F);
+    return ch < 0X20? ch
+         : (ch & ~0XFF) == 0X2800? 0X2800 | (ch&0X3F)
+         : 0X2800 | (table.dots(ch)&0X3F);
+  }
+};
+
+// A lookup for qi::symbols<> keyed by six-dot braille cells.  Every node has
+// one slot per dot pattern, so matching the next cell of the input is a
+// single array index instead of a walk down a ternary search tree.  Like
+// qi::tst<>, find() returns the longest match.
+
+template <typename T>
+class cell_trie
+{
+  typedef std::uint16_t index;
+  struct node
+  {
+    std::array<index, 64> next;
+    T *data = nullptr;
+    node() { next.fill(0); }
+  };
+  std::deque<node> nodes;
+  std::deque<T> values;
+
+  template <typename Char>
+  static bool is_cell(Char c) { return (c & ~0X3F) == 0X2800; }
+
+  template <typename F>
+  void for_each(index i, std::wstring &key, F &f) const
+  {
+    if (nodes[i].data) f(key, *nodes[i].data);
+    for (unsigned dots = 0; dots < 64; ++dots)
+      if (index child = nodes[i].next[dots]) {
+        key.push_back(wchar_t(0X2800 | dots));
+        for_each(child, key, f);
+        key.pop_back();
+      }
+  }
+
+public:
+  typedef wchar_t char_type;
+  typedef T value_type;
+
+  cell_trie() : nodes(1) {}
+
+  template <typename Iterator, typename Filter>
+  T *find(Iterator &first, Iterator last, Filter filter) const
+  {
+    T *found = nullptr;
+    index i = 0;
+    for (Iterator current = first; current != last; ) {
+      auto const c = filter(*current);
+      if (!is_cell(c) || !(i = nodes[i].next[c & 0X3F])) break;
+      ++current;
+      if (nodes[i].data) {
+        found = nodes[i].data;
+        first = current;
+      }
+    }
+    return found;
+  }
+
+  template <typename Iterator>
+  T *find(Iterator &first, Iterator last) const
+  { return find(first, last, boost::spirit::qi::tst_pass_through()); }
+
+  template <typename Iterator>
+  T *add(Iterator first, Iterator last,
+         typename boost::call_traits<T>::param_type val)
+  {
+    index i = 0;
+    for (; first != last; ++first) {
+      BOOST_ASSERT(is_cell(*first));
+      index &next = nodes[i].next[*first & 0X3F];
+      if (!next) {
+        BOOST_ASSERT(nodes.size() <= std::numeric_limits<index>::max());
+        next = index(nodes.size());
+        nodes.emplace_back();
+      }
+      i = next;
+    }
+    if (!nodes[i].data) {
+      values.push_back(val);
+      nodes[i].data = &values.back();
+    }
+    return nodes[i].data;
+  }
+
+  template <typename Iterator>
+  void remove(Iterator first, Iterator last)
+  {
+    index i = 0;
+    for (; first != last; ++first)
+      if (!is_cell(*first) || !(i = nodes[i].next[*first & 0X3F])) return;
+    nodes[i].data = nullptr;
+  }
+
+  void clear() { nodes.resize(1); nodes.front() = node(); values.clear(); }
+
+  template <typename F>
+  void for_each(F f) const
+  {
+    std::wstring key;
+    for_each(0, key, f);
   }
 };
 
 template <typename T = boost::spirit::unused_type>
-struct brl_symbols : boost::spirit::qi::symbols<wchar_t, T, boost::spirit::qi::tst<wchar_t, T>, tst_braillify>
+struct brl_symbols
+: boost::spirit::qi::symbols<wchar_t, T, cell_trie<T>, braillify>
 {};
 
 // A number of generally useful symbol tables for parsing braille music code
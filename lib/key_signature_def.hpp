@@ -13,6 +13,7 @@
 #include <boost/spirit/include/phoenix_stl.hpp>
 #include "brlsym.hpp"
 #include <bmc/braille/parsing/qi/primitive/brl.hpp>
+#include <bmc/braille/parsing/profile.hpp>
 
 namespace bmc { namespace braille {
 
@@ -40,6 +41,8 @@ key_signature_grammar<Iterator>::key_signature_grammar()
 
   flat_sign = brl(126) >> attr(-1);
   sharp_sign = brl(146) >> attr(1);
+
+  BMC_PROFILE_RULES("key_signature", (start)(flat_sign)(sharp_sign))
 }
 
 }}
@@ -6,7 +6,6 @@
 
 #include "bmc/lilypond.hpp"
 #include <algorithm>
-#include <iterator>
 #include <iostream>
 
 namespace bmc { namespace lilypond {
@@ -15,41 +14,40 @@ generator::generator( std::ostream &os
                     , bool layout
                     , bool midi
                     , bool include_locations)
-: os(os)
+: out(os)
 , layout(layout)
 , midi(midi)
 , include_locations(include_locations)
 , last_type(), last_dots(0)
 {
-  os.imbue(std::locale::classic());
-  os << "% Automatically generated by BMC, the braille music compiler"
-     << std::endl;
-  os << "\\version" << " " << "\"2.14.2\"" << std::endl;
-  os << "\\include" << ' ' << "\"articulate.ly\"" << std::endl;
+  out << "% Automatically generated by BMC, the braille music compiler\n";
+  out << "\\version" << " " << "\"2.14.2\"\n";
+  out << "\\include" << ' ' << "\"articulate.ly\"\n";
 }
 
 void
 generator::operator() (braille::ast::score const &score)
 {
   if (no_tagline)
-    os << "\\header {" << std::endl
-       << "  tagline = \"\"" << std::endl
-       << "}" << std::endl;
-  os << "music =" << std::endl;
-  os << "  " << "<<" << std::endl;
+    out << "\\header {\n"
+        << "  tagline = \"\"\n"
+        << "}\n";
+  out << "music =\n";
+  out << "  " << "<<\n";
   for (auto const& part: score.unfolded_part) (*this)(part, score);
-  os << "  " << ">>" << std::endl << std::endl;
+  out << "  " << ">>\n\n";
 
   if (layout)
-    os << "\\score {" << std::endl
-       << "  " << "\\music" << std::endl
-       << "  " << "\\layout { }" << std::endl
-       << "}" << std::endl;
+    out << "\\score {\n"
+        << "  " << "\\music\n"
+        << "  " << "\\layout { }\n"
+        << "}\n";
   if (midi)
-    os << "\\score {" << std::endl
-       << "  " << "\\unfoldRepeats \\articulate \\music" << std::endl
-       << "  " << "\\midi { }" << std::endl
-       << "}" << std::endl;
+    out << "\\score {\n"
+        << "  " << "\\unfoldRepeats \\articulate \\music\n"
+        << "  " << "\\midi { }\n"
+        << "}\n";
+  out.flush();
 }
 
 namespace {
@@ -94,46 +92,46 @@ generator::operator() ( braille::ast::unfolded::part const &part
   bool const keyboard = part.size() == 2;
   indent = "    ";
   if (keyboard) {
-    os << indent << "\\new PianoStaff ";
+    out << indent << "\\new PianoStaff ";
     if (!default_instrument.empty())
-      os << "\\with {midiInstrument = #\"" << default_instrument << "\"} ";
-    os << "<<" << std::endl;
+      out << "\\with {midiInstrument = #\"" << default_instrument << "\"} ";
+    out << "<<\n";
     indent += "  ";
   }
   for (size_t staff_index = 0; staff_index < part.size(); ++staff_index) {
-    os << indent << "\\new Staff ";
+    out << indent << "\\new Staff ";
     if (keyboard) {
       switch (staff_index) {
-      case 0: os << "= \"RH\" "; break;
-      case 1: os << "= \"LH\" "; break;
+      case 0: out << "= \"RH\" "; break;
+      case 1: out << "= \"LH\" "; break;
       }
     }
     if (!keyboard && !default_instrument.empty())
-      os << "\\with {midiInstrument = #\"" << default_instrument << "\"} ";
-    os << "{" << std::endl;
+      out << "\\with {midiInstrument = #\"" << default_instrument << "\"} ";
+    out << "{\n";
 
     if (keyboard) {
       switch (staff_index) {
-      case 0: os << indent << "  "; ly_clef("treble"); break;
-      case 1: os << indent << "  "; ly_clef("bass"); break;
+      case 0: out << indent << "  "; ly_clef("treble"); break;
+      case 1: out << indent << "  "; ly_clef("bass"); break;
       default: BOOST_ASSERT(false);
       }
-      os << std::endl;
+      out << '\n';
     }
 
     if (score.key_sig != 0) {
-      os << indent << "  "; ly_key(score.key_sig); os << std::endl;
+      out << indent << "  "; ly_key(score.key_sig); out << '\n';
     }
 
     if (!score.time_sigs.empty())
-      os << indent << "  " << "\\time" << " " << score.time_sigs.front() << std::endl;
+      out << indent << "  " << "\\time" << " " << score.time_sigs.front() << '\n';
 
     unsigned int measure_number = 1;
     if (!part[staff_index].empty()) {
       rational first_measure_duration(duration(part[staff_index].front()));
       if ((score.time_sigs.empty() && first_measure_duration != 1) ||
           (!score.time_sigs.empty() && score.time_sigs.front() != first_measure_duration)) {
-        os << indent << "  "; ly_partial(first_measure_duration); os << std::endl;
+        out << indent << "  "; ly_partial(first_measure_duration); out << '\n';
         measure_number = 0; // count from zero if we are dealing with upbeat
       }
     }
@@ -153,7 +151,7 @@ generator::operator() ( braille::ast::unfolded::part const &part
       braille::ast::unfolded::staff_element const&
       this_measure = part[staff_index][measure_index];
 
-      os << indent << "  "; apply_visitor(*this, this_measure);
+      out << indent << "  "; apply_visitor(*this, this_measure);
 
       bool barcheck = true;
       repeat_info this_repeat(this_measure);
@@ -162,53 +160,53 @@ generator::operator() ( braille::ast::unfolded::part const &part
         next_measure = part[staff_index][measure_index + 1];
         repeat_info next_repeat(next_measure);
         if (this_repeat.end && next_repeat.begin) {
-          os << " " << "\\bar \":|:\"" << " ";
+          out << " " << "\\bar \":|:\"" << " ";
           barcheck = false;
         } else if (next_repeat.begin) {
-          os << " " << "\\bar \"|:\"" << " ";
+          out << " " << "\\bar \"|:\"" << " ";
           barcheck = false;
         }
       }
       if (barcheck && this_repeat.end) {
-        os << " " << "\\bar \":|\"" << " ";
+        out << " " << "\\bar \":|\"" << " ";
         barcheck = false;
       }
-      if (barcheck) os << " | ";
-      os << "% " << measure_number++ << std::endl;
+      if (barcheck) out << " | ";
+      out << "% " << measure_number++ << '\n';
       }
     }
-    os << indent << "}" << std::endl;
+    out << indent << "}\n";
   }
-  if (part.size() == 2) os << "    " << ">>" << std::endl;
+  if (part.size() == 2) out << "    " << ">>\n";
 }
 
 generator::result_type
 generator::operator() (braille::ast::key_and_time_signature const &key_and_time_sig)
 {
-  os << " \\time "
-     << key_and_time_sig.time.numerator()
-     << '/'
-     << key_and_time_sig.time.denominator()
-     << ' ';
+  out << " \\time "
+      << key_and_time_sig.time.numerator()
+      << '/'
+      << key_and_time_sig.time.denominator()
+      << ' ';
 }
 
 generator::result_type
 generator::operator() (braille::ast::unfolded::measure const &measure)
 {
-  if (measure.count > 1) os << "\\repeat unfold " << measure.count << " { ";
+  if (measure.count > 1) out << "\\repeat unfold " << measure.count << " { ";
   if (measure.voices.size() == 1) {
     (*this)(measure.voices.front());
   } else {
-    os << "<< ";
+    out << "<< ";
     for (size_t voice_index = 0; voice_index < measure.voices.size();
          ++voice_index)
     {
-      os << "{"; (*this)(measure.voices[voice_index]); os << "}";
-      if (voice_index != measure.voices.size() - 1) os << "\\\\";
+      out << "{"; (*this)(measure.voices[voice_index]); out << "}";
+      if (voice_index != measure.voices.size() - 1) out << "\\\\";
     }
-    os << " >>";
+    out << " >>";
   }
-  if (measure.count > 1) os << " }";
+  if (measure.count > 1) out << " }";
 }
 
 void
@@ -218,7 +216,7 @@ generator::operator() (braille::ast::unfolded::voice const &voice)
        ++partial_measure_index)
   {
     (*this)(voice[partial_measure_index]);
-    if (partial_measure_index != voice.size() - 1) os << " ";
+    if (partial_measure_index != voice.size() - 1) out << " ";
   }
 }
 
@@ -228,14 +226,14 @@ generator::operator() (braille::ast::unfolded::partial_measure const &partial_me
   if (partial_measure.size() == 1) {
     (*this)(partial_measure.front());
   } else {
-    os << "<< ";
+    out << "<< ";
     for (size_t voice_index = 0; voice_index < partial_measure.size();
          ++voice_index)
     {
-      os << "{"; (*this)(partial_measure[voice_index]); os << "}";
-      if (voice_index != partial_measure.size() - 1) os << "\\\\";
+      out << "{"; (*this)(partial_measure[voice_index]); out << "}";
+      if (voice_index != partial_measure.size() - 1) out << "\\\\";
     }
-    os << " >>";
+    out << " >>";
   }
 }
 
@@ -247,7 +245,7 @@ generator::operator() (braille::ast::unfolded::partial_voice const &partial_voic
        ++element_index)
   {
     apply_visitor(*this, partial_voice[element_index]);
-    if (element_index != partial_voice.size() - 1) os << " ";
+    if (element_index != partial_voice.size() - 1) out << " ";
   }
 }
 
@@ -271,7 +269,7 @@ generator::operator() (braille::ast::clef const &clef) const
   };
   BOOST_ASSERT(clef.staff_line() > 0);
   if (char const *name = lily_clef[std::size_t(clef.sign)][clef.staff_line() - 1])
-    std::cout << "\\clef" << ' ' << name;
+    out << "\\clef" << ' ' << name;
   else {
     std::cerr << "Unable to transcribe clef to LilyPond" << std::endl;
     BOOST_ASSERT(false);
@@ -287,41 +285,41 @@ generator::result_type
 generator::operator() (braille::ast::rest const &rest)
 {
   for (rational const &factor: rest.tuplet_begin)
-    os << "\\times " << factor << " { ";
+    out << "\\times " << factor << " { ";
   if (rest.whole_measure) {
-    os << "R"; if (rest.type) os << "1" << "*" << rest.type;
+    out << "R"; if (rest.type) out << "1" << "*" << rest.type;
     last_type = 0, last_dots = 0;
   } else {
-    os << "r"; ly_rhythm(rest);
+    out << "r"; ly_rhythm(rest);
   }
 
   using braille::ast::notegroup_member_type;
   switch (rest.notegroup_member) {
     case notegroup_member_type::begin:
-      os << '[';
+      out << '[';
       break;
     case notegroup_member_type::end:
-      os << ']';
+      out << ']';
       break;
     default: break;
   }
 
   if (include_locations) {
-    os << "%{" << rest.id << "%}";
+    out << "%{" << rest.id << "%}";
   }
-  for (unsigned int i = 0; i < rest.tuplet_end; ++i) os << " }";
+  for (unsigned int i = 0; i < rest.tuplet_end; ++i) out << " }";
 }
 
 generator::result_type
 generator::operator() (braille::ast::note const &note)
 {
   for (rational const &factor: note.tuplet_begin)
-    os << "\\times " << factor << " { ";
+    out << "\\times " << factor << " { ";
   bool grace = false;
   for (articulation const& articulation: note.articulations) {
     switch (articulation) {
-    case appoggiatura:             os << "\\appoggiatura "; grace = true; break;
-    case short_appoggiatura:       os << "\\acciaccatura "; grace = true; break;
+    case appoggiatura:             out << "\\appoggiatura "; grace = true; break;
+    case short_appoggiatura:       out << "\\acciaccatura "; grace = true; break;
     }
   }
   ly_pitch_step(note.step);
@@ -329,24 +327,24 @@ generator::operator() (braille::ast::note const &note)
   ly_octave(note.octave);
   if (grace && note.type == zero) {
     switch (note.ambiguous_value) {
-    case braille::ast::whole_or_16th: os << "16"; break;
-    case braille::ast::half_or_32th: os << "32"; break;
-    case braille::ast::quarter_or_64th: os << "4"; break;
-    case braille::ast::eighth_or_128th: os << "8"; break;
+    case braille::ast::whole_or_16th: out << "16"; break;
+    case braille::ast::half_or_32th: out << "32"; break;
+    case braille::ast::quarter_or_64th: out << "4"; break;
+    case braille::ast::eighth_or_128th: out << "8"; break;
     case braille::ast::unknown: BOOST_ASSERT(false);
     }
     last_type = 0, last_dots = 0;
   } else ly_rhythm(note);
-  if (note.tie) os << "~";
+  if (note.tie) out << "~";
   for (articulation const& articulation: note.articulations) {
     switch (articulation) {
     default:                         break;
-    case mordent:                  os << "\\mordent ";      break;
-    case turn_above_or_below_note: os << "\\turn ";         break;
-    case accent:         os << "->"; break;
-    case staccato:       os << "-."; break;
-    case staccatissimo:  os << "-|"; break;
-    case mezzo_staccato: os << "-_"; break;
+    case mordent:                  out << "\\mordent ";      break;
+    case turn_above_or_below_note: out << "\\turn ";         break;
+    case accent:         out << "->"; break;
+    case staccato:       out << "-."; break;
+    case staccatissimo:  out << "-|"; break;
+    case mezzo_staccato: out << "-_"; break;
     }
   }
   ly_finger(note.fingers);
@@ -354,53 +352,53 @@ generator::operator() (braille::ast::note const &note)
   using braille::ast::notegroup_member_type;
   switch (note.notegroup_member) {
     case notegroup_member_type::begin:
-      os << '[';
+      out << '[';
       break;
     case notegroup_member_type::end:
-      os << ']';
+      out << ']';
       break;
     default: break;
   }
 
   switch (note.slur_member) {
   default: break;
-  case braille::ast::slur_member_type::begin: os << '('; break;
-  case braille::ast::slur_member_type::end:   os << ')'; break;
+  case braille::ast::slur_member_type::begin: out << '('; break;
+  case braille::ast::slur_member_type::end:   out << ')'; break;
   }
 
   if (include_locations) {
-    os << "%{" << note.id << "%}";
+    out << "%{" << note.id << "%}";
   }
-  for (unsigned int i = 0; i < note.tuplet_end; ++i) os << " }";
+  for (unsigned int i = 0; i < note.tuplet_end; ++i) out << " }";
 }
 
 generator::result_type
 generator::operator() (braille::ast::chord const &chord)
 {
-  os << "<";
+  out << "<";
   ly_pitch_step(chord.base.step);
   ly_accidental(chord.base.alter);
   ly_octave(chord.base.octave);
-  if (chord.base.tie) os << "~";
+  if (chord.base.tie) out << "~";
   ly_finger(chord.base.fingers);
   for (braille::ast::interval const& interval: chord.intervals) {
-    os << " ";
+    out << " ";
     ly_pitch_step(interval.step);
     ly_accidental(interval.alter);
     ly_octave(interval.octave);
-    if (interval.tie) os << "~";
+    if (interval.tie) out << "~";
     ly_finger(interval.fingers);
   }
-  os << ">";
+  out << ">";
   ly_rhythm(chord.base);
 
   using braille::ast::notegroup_member_type;
   switch (chord.base.notegroup_member) {
     case notegroup_member_type::begin:
-      os << '[';
+      out << '[';
       break;
     case notegroup_member_type::end:
-      os << ']';
+      out << ']';
       break;
     default: break;
   }
@@ -409,57 +407,57 @@ generator::operator() (braille::ast::chord const &chord)
 generator::result_type
 generator::operator() (braille::ast::moving_note const &chord)
 {
-  os << "<<{";
+  out << "<<{";
   last_type = 0, last_dots = 0;
   (*this)(chord.base);
-  os << "}\\\\{";
+  out << "}\\\\{";
   // @todo Account for dotted intervals.
   rational const moving_type(chord.base.as_rational() / int(chord.intervals.size()));
   for (braille::ast::interval const& interval: chord.intervals) {
-    os << " ";
+    out << " ";
     ly_pitch_step(interval.step);
     ly_accidental(interval.alter);
     ly_octave(interval.octave);
-    os << moving_type.denominator();
-    if (moving_type.numerator() != 1) os << '*' << moving_type.numerator();
-    if (interval.tie) os << "~";
+    out << moving_type.denominator();
+    if (moving_type.numerator() != 1) out << '*' << moving_type.numerator();
+    if (interval.tie) out << "~";
     ly_finger(interval.fingers);
   }
-  os << " }>>";
+  out << " }>>";
   last_type = 0, last_dots = 0;         // Next note should have rhythm info
 }
 
 void
 generator::ly_accidental(int alteration) const
 {
-  while (alteration < 0) { os << "es"; ++alteration; }
-  while (alteration > 0) { os << "is"; --alteration; }
+  while (alteration < 0) { out << "es"; ++alteration; }
+  while (alteration > 0) { out << "is"; --alteration; }
 }
 
 void
 generator::ly_clef(std::string const& clef) const
 {
-  os << "\\clef \"" << clef << "\"";
+  out << "\\clef \"" << clef << "\"";
 }
 
 namespace {
 
 class print_fingering: public boost::static_visitor<>
 {
-  std::ostream &os;
+  output_buffer &out;
 public:
-  print_fingering(std::ostream &os): os(os) {}
+  print_fingering(output_buffer &out): out(out) {}
   result_type operator() (braille::finger_change const &change) const
   {
-    os << "^\\markup { \\finger \"" 
-       << change.first << " - " << change.second
-       << "\" }";
+    out << "^\\markup { \\finger \"" 
+        << change.first << " - " << change.second
+        << "\" }";
 
     return;
   }
   result_type operator() (unsigned finger) const
   {
-    os << "-" << finger;
+    out << "-" << finger;
 
     return;
   }
@@ -470,8 +468,8 @@ public:
 void
 generator::ly_finger(braille::fingering_list const &fingers) const
 {
-  print_fingering const write_to_stream(os);
-  for_each(fingers.begin(), fingers.end(), apply_visitor(write_to_stream));
+  print_fingering const write_to_buffer(out);
+  for_each(fingers.begin(), fingers.end(), apply_visitor(write_to_buffer));
 }
 
 void
@@ -479,20 +477,20 @@ generator::ly_key(key_signature const &key) const
 {
   char const *flats[] = { "f", "bes", "ees", "aes", "des", "ges", "ces" };
   char const *sharps[] = { "g", "d", "a", "e", "b", "fis", "cis" };
-  os << "\\key" << " ";
-  if (key > 0) os << sharps[key - 1];
-  else if (key < 0) os << flats[-key - 1];
-  else os << "c";
-  os << " " << "\\major";
+  out << "\\key" << " ";
+  if (key > 0) out << sharps[key - 1];
+  else if (key < 0) out << flats[-key - 1];
+  else out << "c";
+  out << " " << "\\major";
 }
 
 void
 generator::ly_rhythm(braille::ast::rhythmic_data const &rhythm)
 {
   if (rhythm.type != last_type || rhythm.dots != last_dots) {
-    os << rhythm.type.denominator();
-    if (rhythm.type.numerator() != 1) os << '*' << rhythm.type.numerator();
-    std::fill_n(std::ostream_iterator<char>(os), rhythm.dots, '.');
+    out << rhythm.type.denominator();
+    if (rhythm.type.numerator() != 1) out << '*' << rhythm.type.numerator();
+    out.fill(rhythm.dots, '.');
     last_type = rhythm.type, last_dots = rhythm.dots;
   }
 }
@@ -501,23 +499,23 @@ void
 generator::ly_octave(int octave) const
 {
   int const default_octave = 4;
-  while (octave > default_octave) { os << "'"; --octave; };
-  while (octave < default_octave) { os << ","; ++octave; };
+  while (octave > default_octave) { out << "'"; --octave; };
+  while (octave < default_octave) { out << ","; ++octave; };
 }
 
 void
 generator::ly_partial(rational const& duration) const
 {
-  os << "\\partial" << " " << duration.denominator();
-  if (duration.numerator() != 1) os << "*" << duration.numerator();
-  os << " ";
+  out << "\\partial" << " " << duration.denominator();
+  if (duration.numerator() != 1) out << "*" << duration.numerator();
+  out << " ";
 }
 
 void
 generator::ly_pitch_step(diatonic_step step) const
 {
   static char const* steps = "cdefgab";
-  os << steps[step];
+  out << steps[step];
 }
 
 namespace {
@@ -605,13 +603,13 @@ generator::process_repeat_with_alternatives( braille::ast::unfolded::staff const
 
   if (!alternatives.empty()) {
     // We found a section of repeated music with alternative endings.
-    os << indent << "  " << "\\repeat volta " << alternatives.size() << " {" << std::endl;
+    out << indent << "  " << "\\repeat volta " << alternatives.size() << " {\n";
     for (std::size_t measure_index = index;
          measure_index < alternatives.front().front(); ++measure_index)
     {
       braille::ast::unfolded::staff_element const& this_measure = staff[measure_index];
 
-      os << indent << "    "; apply_visitor(*this, this_measure);
+      out << indent << "    "; apply_visitor(*this, this_measure);
 
       bool barcheck = true;
       repeat_info this_repeat(this_measure);
@@ -620,33 +618,33 @@ generator::process_repeat_with_alternatives( braille::ast::unfolded::staff const
         next_measure = staff[measure_index + 1];
         repeat_info next_repeat(next_measure);
         if (this_repeat.end && next_repeat.begin) {
-          os << " " << "\\bar \":|:\"" << " ";
+          out << " " << "\\bar \":|:\"" << " ";
           barcheck = false;
         } else if (next_repeat.begin) {
-          os << " " << "\\bar \"|:\"" << " ";
+          out << " " << "\\bar \"|:\"" << " ";
           barcheck = false;
         }
       }
       if (barcheck && this_repeat.end) {
-        os << " " << "\\bar \":|\"" << " ";
+        out << " " << "\\bar \":|\"" << " ";
         barcheck = false;
       }
-      if (barcheck) os << " |" << std::endl;
+      if (barcheck) out << " |\n";
     }
-    os << indent << "  " << "}" << std::endl;
+    out << indent << "  " << "}\n";
 
-    os << indent << "  " << "\\alternative {" << std::endl;
+    out << indent << "  " << "\\alternative {\n";
     for (auto indices: alternatives) {
-      os << indent << "    " << "{";
+      out << indent << "    " << "{";
       for (std::size_t measure_index: indices) {
         braille::ast::unfolded::staff_element const& this_measure = staff[measure_index];
 
         apply_visitor(*this, this_measure);
-        if (apply_visitor(is_measure(), this_measure)) os << " | ";
+        if (apply_visitor(is_measure(), this_measure)) out << " | ";
       }
-      os << "}" << std::endl;
+      out << "}\n";
     }
-    os << indent << "  " << "}" << std::endl;
+    out << indent << "  " << "}\n";
     return i;
   }
   return index;
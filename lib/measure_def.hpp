@@ -12,6 +12,7 @@
 #include <bmc/braille/parsing/qi/primitive/brl.hpp>
 #include "brlsym.hpp"
 #include <bmc/braille/parsing/error_handler.hpp>
+#include <bmc/braille/parsing/profile.hpp>
 #include <bmc/braille/parsing/annotation.hpp>
 #include <boost/spirit/include/qi_core.hpp>
 #include <boost/spirit/include/qi_eol.hpp>
@@ -24,6 +25,7 @@
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include <boost/phoenix/statement/sequence.hpp>
 #include <boost/fusion/include/std_pair.hpp>
+#include "spirit/detail/move_into_container.hpp"
 
 namespace bmc { namespace braille {
 
@@ -59,7 +61,7 @@ measure_grammar<Iterator>::measure_grammar(error_handler<Iterator>& error_handle
 
 #define BMC_LOCATABLE_SET_ID(rule) \
   boost::spirit::qi::on_success(rule,\
-                                annotation_function(error_handler.ranges)\
+                                annotation_function(error_handler)\
                                 (_val, _1, _3))
   BMC_LOCATABLE_SET_ID(start);
   BMC_LOCATABLE_SET_ID(voice);
@@ -68,6 +70,11 @@ measure_grammar<Iterator>::measure_grammar(error_handler<Iterator>& error_handle
 #undef BMC_LOCATABLE_SET_ID
   
   optional_dot.name(".");
+
+  BMC_PROFILE_RULES("measure",
+    (start)(voice)(partial_measure)(partial_voice)(full_measure_in_accord)
+    (partial_measure_sign)(partial_measure_in_accord)(optional_dot)(ending)
+  )
 }
 
 }}
@@ -0,0 +1,415 @@
+// Copyright (C) 2026  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#include "bmc/midi.hpp"
+#include "bmc/lilypond.hpp"
+#include "bmc/braille/ast/duration.hpp"
+#include "bmc/braille/ast/visitors.hpp"
+#include <boost/integer/common_factor_rt.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bmc { namespace midi {
+
+namespace {
+
+bool has_barline( braille::ast::unfolded::staff_element const &element
+                , braille::ast::barline type
+                )
+{
+  auto const measure = boost::get<braille::ast::unfolded::measure>(&element);
+  if (measure)
+    for (auto const &voice: measure->voices)
+      for (auto const &partial_measure: voice)
+        for (auto const &partial_voice: partial_measure)
+          for (auto const &sign: partial_voice)
+            if (auto const barline = boost::get<braille::ast::barline>(&sign))
+              if (*barline == type) return true;
+  return false;
+}
+
+boost::optional<unsigned>
+ending(braille::ast::unfolded::staff_element const &element)
+{
+  auto const measure = boost::get<braille::ast::unfolded::measure>(&element);
+  return measure? measure->ending: boost::none;
+}
+
+// Is there an alternative ending with the given number before the next
+// repeated section starts?
+bool has_ending( braille::ast::unfolded::staff const &staff
+               , std::size_t index, unsigned number
+               )
+{
+  for (; index < staff.size(); ++index) {
+    if (has_barline(staff[index], braille::ast::begin_repeat)) break;
+    if (ending(staff[index]) == number) return true;
+    if (has_barline(staff[index], braille::ast::end_part)) break;
+  }
+  return false;
+}
+
+/**
+ * \brief Determine the order in which the elements of a staff are played.
+ *
+ * A section ending with a repeat sign is played twice.  If it has
+ * alternative endings, it is played once for every ending, skipping the
+ * endings which do not belong to the current pass.
+ */
+std::vector<std::size_t>
+playback_order(braille::ast::unfolded::staff const &staff)
+{
+  std::vector<std::size_t> order;
+  std::size_t repeat_begin = 0;
+  unsigned pass = 1;
+  boost::optional<unsigned> alternative;
+  for (std::size_t index = 0; index < staff.size(); ++index) {
+    if (index != repeat_begin &&
+        has_barline(staff[index], braille::ast::begin_repeat)) {
+      repeat_begin = index, pass = 1, alternative = boost::none;
+    }
+    if (auto const number = ending(staff[index])) alternative = number;
+    // A time signature preceding an alternative ending belongs to it.
+    boost::optional<unsigned> const next_ending =
+      index + 1 < staff.size() &&
+      !boost::get<braille::ast::unfolded::measure>(&staff[index])?
+      ending(staff[index + 1]): boost::none;
+    bool const skip = (alternative && *alternative != pass) ||
+                      (next_ending && *next_ending != pass);
+    if (!skip) order.push_back(index);
+
+    if (has_barline(staff[index], braille::ast::end_repeat)) {
+      if (!skip &&
+          (alternative? has_ending(staff, index + 1, pass + 1): pass == 1)) {
+        index = repeat_begin - 1, ++pass, alternative = boost::none;
+        continue;
+      }
+      if (!alternative || !skip) {
+        repeat_begin = index + 1, pass = 1, alternative = boost::none;
+      }
+    }
+    if (has_barline(staff[index], braille::ast::end_part)) {
+      repeat_begin = index + 1, pass = 1, alternative = boost::none;
+    }
+  }
+  return order;
+}
+
+int key_number(braille::ast::pitched const &pitch)
+{
+  static int const chromatic[steps_per_octave] = { 0, 2, 4, 5, 7, 9, 11 };
+  return pitch.octave * 12 + chromatic[pitch.step] + pitch.alter;
+}
+
+/**
+ * \brief Perform a staff, appending every sounding note to a vector.
+ *
+ * Tied notes are joined into a single note.
+ */
+class performer : public boost::static_visitor<void>
+{
+  performance::staff &staff;
+  int const velocity;
+  rational now;
+  std::vector<note> tied;
+
+  void sound( braille::ast::pitched const &pitch
+            , rational const &begin, rational const &duration, bool tie
+            )
+  {
+    note sounding { begin, duration, staff.channel, key_number(pitch), velocity };
+    auto const pending = std::find_if(tied.begin(), tied.end(),
+                                      [&sounding](note const &n) {
+                                        return n.key == sounding.key;
+                                      });
+    if (pending != tied.end()) {
+      if (pending->begin + pending->duration == begin) {
+        sounding.begin = pending->begin;
+        sounding.duration += pending->duration;
+      } else {
+        staff.notes.push_back(*pending);
+      }
+      tied.erase(pending);
+    }
+    if (tie) tied.push_back(sounding); else staff.notes.push_back(sounding);
+  }
+
+public:
+  std::vector<std::pair<rational, braille::ast::key_and_time_signature const *>>
+  signatures;
+
+  performer(performance::staff &staff, int velocity)
+  : staff(staff), velocity(velocity) {}
+
+  void operator()(braille::ast::unfolded::staff const &elements)
+  {
+    for (std::size_t index: playback_order(elements))
+      apply_visitor(*this, elements[index]);
+    staff.notes.insert(staff.notes.end(), tied.begin(), tied.end());
+    tied.clear();
+  }
+
+  result_type operator()(braille::ast::unfolded::measure const &measure)
+  {
+    for (unsigned count = 0; count < measure.count; ++count) {
+      for (auto const &voice: measure.voices) {
+        rational voice_position(staff.end);
+        for (auto const &partial_measure: voice) {
+          for (auto const &partial_voice: partial_measure) {
+            now = voice_position;
+            std::for_each(partial_voice.begin(), partial_voice.end(),
+                          apply_visitor(*this));
+          }
+          voice_position += duration(partial_measure);
+        }
+      }
+      staff.end += duration(measure);
+    }
+  }
+
+  result_type operator()(braille::ast::key_and_time_signature const &signature)
+  { signatures.emplace_back(staff.end, &signature); }
+
+  result_type operator()(braille::ast::note const &note)
+  {
+    if (braille::ast::is_grace(note)) return;
+    sound(note, now, note.as_rational(), bool(note.tie));
+    now += note.as_rational();
+  }
+  result_type operator()(braille::ast::rest const &rest)
+  { now += rest.as_rational(); }
+  result_type operator()(braille::ast::chord const &chord)
+  {
+    if (braille::ast::is_grace(chord.base)) return;
+    bool const tie = chord.all_tied || chord.base.tie;
+    sound(chord.base, now, chord.as_rational(), tie);
+    for (auto const &interval: chord.intervals)
+      sound(interval, now, chord.as_rational(), tie || interval.tie);
+    now += chord.as_rational();
+  }
+  result_type operator()(braille::ast::moving_note const &moving_note)
+  {
+    if (braille::ast::is_grace(moving_note.base)) return;
+    sound(moving_note.base, now, moving_note.as_rational(),
+          bool(moving_note.base.tie));
+    rational const step(moving_note.as_rational() /
+                        int(moving_note.intervals.size()));
+    rational at(now);
+    for (auto const &interval: moving_note.intervals) {
+      sound(interval, at, step, bool(interval.tie));
+      at += step;
+    }
+    now += moving_note.as_rational();
+  }
+  template<typename Sign> result_type operator()(Sign const &) {}
+};
+
+// The number of ticks per quarter note needed to express a time.
+rational::int_type ppq(rational const &time)
+{ return (time * 4).denominator(); }
+
+/**
+ * \brief The content of a track chunk.
+ */
+class track
+{
+  std::string data;
+  std::uint32_t time = 0;
+
+  void number(std::uint32_t value)
+  {
+    char bytes[5];
+    int count = 0;
+    bytes[count++] = value & 0X7F;
+    while (value >>= 7) bytes[count++] = 0X80 | (value & 0X7F);
+    while (count) data += bytes[--count];
+  }
+
+public:
+  void message(std::uint32_t tick, std::initializer_list<int> bytes)
+  {
+    BOOST_ASSERT(tick >= time);
+    number(tick - time);
+    time = tick;
+    for (int byte: bytes) data += char(byte);
+  }
+
+  void operator()(event const &event)
+  {
+    message(event.tick, { event.status, event.key,
+                          event.note_on()? event.velocity: 64 });
+  }
+
+  void finish(std::uint32_t tick) { message(std::max(tick, time), { 0XFF, 0X2F, 0 }); }
+
+  void write(std::ostream &os) const
+  {
+    std::uint32_t const size = data.size();
+    char const header[] = { 'M', 'T', 'r', 'k'
+                          , char(size >> 24), char(size >> 16)
+                          , char(size >> 8), char(size)
+                          };
+    os.write(header, sizeof(header));
+    os.write(data.data(), data.size());
+  }
+};
+
+void time_signature_event(track &conductor, std::uint32_t tick,
+                          time_signature const &time)
+{
+  int exponent = 0;
+  while ((1 << exponent) < time.denominator()) ++exponent;
+  conductor.message(tick, { 0XFF, 0X58, 4, int(time.numerator()), exponent,
+                            24, 8 });
+}
+
+void key_signature_event(track &conductor, std::uint32_t tick,
+                         key_signature key)
+{ conductor.message(tick, { 0XFF, 0X59, 2, key & 0XFF, 0 }); }
+
+}
+
+performance::performance(braille::ast::score const &score, int velocity)
+{
+  for (std::size_t part = 0; part < score.unfolded_part.size(); ++part) {
+    // Channel 10 is reserved for percussion.
+    int const channel = (part < 9? part: part + 1) % 16;
+    for (auto const &elements: score.unfolded_part[part]) {
+      staves.push_back(staff { channel, {}, zero });
+      performer perform(staves.back(), velocity);
+      perform(elements);
+      if (staves.size() == 1) signatures = std::move(perform.signatures);
+    }
+  }
+}
+
+rational::int_type performance::ppq() const
+{
+  rational::int_type result = 1;
+  auto const include = [&result](rational const &time) {
+    rational::int_type const value = midi::ppq(time);
+    if (result % value) result = boost::integer::lcm(result, value);
+  };
+  for (auto const &staff: staves) {
+    for (auto const &note: staff.notes) {
+      include(note.begin);
+      include(note.duration);
+    }
+    include(staff.end);
+  }
+  for (auto const &signature: signatures) include(signature.first);
+  return result;
+}
+
+std::uint32_t ticks(rational const &time, rational::int_type ppq)
+{
+  BOOST_ASSERT((4 * ppq) % time.denominator() == 0);
+  std::int64_t const value =
+    std::int64_t(time.numerator()) * (4 * ppq / time.denominator());
+  if (value > 0X0FFFFFFF)
+    throw std::runtime_error("Score too long for MIDI");
+  return value;
+}
+
+std::vector<event> events(performance::staff const &staff,
+                          rational::int_type ppq)
+{
+  std::vector<event> result;
+  result.reserve(2 * staff.notes.size());
+  for (auto const &note: staff.notes) {
+    std::uint8_t const key = note.key, velocity = note.velocity;
+    result.push_back({ ticks(note.begin, ppq),
+                       std::uint8_t(0X90 | note.channel), key, velocity });
+    result.push_back({ ticks(note.begin + note.duration, ppq),
+                       std::uint8_t(0X80 | note.channel), key, 0 });
+  }
+  std::stable_sort(result.begin(), result.end());
+  return result;
+}
+
+std::vector<event> merge(std::vector<std::vector<event>> const &staves)
+{
+  // There are only a few staves, picking the earliest head among them is
+  // cheaper than maintaining a heap.
+  std::size_t size = 0;
+  for (auto const &events: staves) size += events.size();
+  std::vector<event> result;
+  result.reserve(size);
+  std::vector<std::vector<event>::const_iterator> heads;
+  for (auto const &events: staves) heads.push_back(events.begin());
+  while (result.size() < size) {
+    std::size_t earliest = staves.size();
+    for (std::size_t index = 0; index < staves.size(); ++index) {
+      if (heads[index] != staves[index].end() &&
+          (earliest == staves.size() || *heads[index] < *heads[earliest]))
+        earliest = index;
+    }
+    result.push_back(*heads[earliest]++);
+  }
+  return result;
+}
+
+int program(std::string const &instrument)
+{
+  auto const found = std::find(std::begin(lilypond::instruments),
+                               std::end(lilypond::instruments), instrument);
+  return found != std::end(lilypond::instruments)?
+         found - std::begin(lilypond::instruments): 0;
+}
+
+void standard_midi_file( std::ostream &os
+                       , braille::ast::score const &score
+                       , int program
+                       , unsigned beats_per_minute
+                       )
+{
+  performance const performed(score);
+  rational::int_type const ppq = performed.ppq();
+  if (ppq > 0X7FFF)
+    throw std::runtime_error("Rhythm too fine for a Standard MIDI File");
+
+  std::uint16_t const tracks = 1 + performed.staves.size();
+  char const header[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6
+                        , 0, 1
+                        , char(tracks >> 8), char(tracks)
+                        , char(ppq >> 8), char(ppq)
+                        };
+  os.write(header, sizeof(header));
+
+  {
+    track conductor;
+    std::uint32_t const tempo = 60000000 / beats_per_minute;
+    conductor.message(0, { 0XFF, 0X51, 3, int(tempo >> 16 & 0XFF),
+                           int(tempo >> 8 & 0XFF), int(tempo & 0XFF) });
+    if (!score.time_sigs.empty())
+      time_signature_event(conductor, 0, score.time_sigs.front());
+    key_signature_event(conductor, 0, score.key_sig);
+    for (auto const &signature: performed.signatures) {
+      std::uint32_t const tick = ticks(signature.first, ppq);
+      time_signature_event(conductor, tick, signature.second->time);
+      key_signature_event(conductor, tick, signature.second->key);
+    }
+    conductor.finish(performed.staves.empty()? 0:
+                     ticks(performed.staves.front().end, ppq));
+    conductor.write(os);
+  }
+
+  for (auto const &staff: performed.staves) {
+    track chunk;
+    chunk.message(0, { 0XC0 | staff.channel, program & 0X7F });
+    for (auto const &event: events(staff, ppq)) chunk(event);
+    chunk.finish(ticks(staff.end, ppq));
+    chunk.write(os);
+  }
+}
+
+}}
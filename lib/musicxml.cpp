@@ -7,41 +7,20 @@
 #include <bmc/musicxml.hpp>
 #include <xsdcxx-musicxml/musicxml.hpp>
 #include <bmc/braille/ast/visitor.hpp>
+#include "musicxml_common.hpp"
 #include <boost/variant/get.hpp>
 
 namespace bmc {
 
 namespace {
 
+using detail::is_anacrusis;
+
 // We are going to export score-partwise documents.
 using score_type = ::musicxml::score_partwise;
 using part_type = score_type::part_type;
 using measure_type = part_type::measure_type;
 
-// Determine the greatest common divisor of all rhythmic values in a braille score.
-// We need this for the MusicXML divisons element.
-// We're basically determining the common denominator such that all
-// rhythmic values can be expressed as an integer, since the MusicXML duration
-// element is not a rational.
-
-rational duration_gcd(braille::ast::score const &score) {
-  class gcd_visitor : public braille::ast::const_visitor<gcd_visitor> {
-    rational value;
-  public:
-    bool visit_rhythmic(braille::ast::rhythmic const &rhythmic) {
-      value = boost::integer::gcd(value, rhythmic.as_rational());
-
-      return true;
-    }
-
-    rational const &get_result() const { return value; }
-  } accumulator;
-
-  accumulator.traverse_score(score);
-
-  return accumulator.get_result();
-}
- 
 // Conversion functions between braille AST and MusicXML objects:
 
 ::musicxml::key xml(key_signature const &key) {
@@ -88,7 +67,8 @@ std::string to_string(rational const & r) {
   }
 }
 
-::musicxml::note::dot_sequence dots(braille::ast::rhythmic const &rhythmic) {
+template <typename Rhythmic>
+::musicxml::note::dot_sequence dots(Rhythmic const &rhythmic) {
   ::musicxml::note::dot_sequence xml_dots;
   std::fill_n(std::back_inserter(xml_dots), rhythmic.get_dots(),
               ::musicxml::empty_placement{});
@@ -151,13 +131,6 @@ fingering(braille::fingering_list const &fingers) {
   return xml_fingers;
 }
 
-bool is_anacrusis(braille::ast::unfolded::measure const &measure,
-                  braille::ast::score const &score) {
-  return
-  (!score.time_sigs.empty() && (duration(measure) != score.time_sigs.front())) ||
-  (score.time_sigs.empty() && duration(measure) != 1);
-}
-
 class starts_with_anacrusis_visitor : public boost::static_visitor<bool> {
   braille::ast::score const &brl_score;
   bool active = true;
@@ -472,13 +445,8 @@ public:
   musicxml_generator(braille::ast::score const &score)
   : brl_score { score }, xml_score { ::musicxml::part_list {} }
   , global_attributes { }
-    // The divisons element expresses the number of "ticks" per quarter note.
-  , divisions {
-    rational{1, 4} / boost::integer::gcd(duration_gcd(brl_score), rational{1, 4})
-    }
+  , divisions { detail::divisions(brl_score) }
   {
-    BOOST_ASSERT(divisions.denominator() == 1);
-
     xml_score.version("3.0");
 
     ::musicxml::encoding encoding { };
@@ -538,7 +506,7 @@ public:
 
 }
 
-void musicxml(::std::ostream &os, braille::ast::score const &score)
+void musicxml_via_xsd(::std::ostream &os, braille::ast::score const &score)
 {
   ::musicxml::serialize(os, musicxml_generator(score).score_partwise());
 }
@@ -0,0 +1,209 @@
+// Copyright (C) 2026  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#include <bmc/musicxml.hpp>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace bmc {
+
+namespace {
+
+/**
+ * \brief Write a ZIP archive to a stream which need not be seekable.
+ *
+ * Sizes and checksums of deflated entries are only known after their data,
+ * so they follow it in a data descriptor.  All entries carry the same
+ * timestamp, which makes archives of the same score identical.
+ */
+class zip_writer {
+  struct entry {
+    std::string name;
+    std::uint16_t flags, method;
+    std::uint32_t crc = 0, compressed_size = 0, size = 0, offset;
+  };
+
+  std::ostream &os;
+  std::uint64_t offset = 0;
+  std::vector<entry> entries;
+
+  static std::uint16_t const dos_time = 0, dos_date = (1 << 5) | 1; // 1980-01-01
+
+  void u16(std::uint16_t value) {
+    char const bytes[] = { char(value & 0XFF), char(value >> 8) };
+    write(bytes, sizeof(bytes));
+  }
+  void u32(std::uint32_t value) {
+    u16(value & 0XFFFF); u16(value >> 16);
+  }
+
+  std::uint32_t checked(std::uint64_t value) {
+    if (value > std::numeric_limits<std::uint32_t>::max())
+      throw std::runtime_error("MusicXML archive exceeds 4GiB");
+    return value;
+  }
+
+  void local_header(entry const &e) {
+    u32(0X04034B50);
+    u16(20); u16(e.flags); u16(e.method); u16(dos_time); u16(dos_date);
+    u32(e.crc); u32(e.compressed_size); u32(e.size);
+    u16(e.name.size()); u16(0);
+    write(e.name.data(), e.name.size());
+  }
+
+  class deflating_buffer;
+
+public:
+  explicit zip_writer(std::ostream &os) : os(os) {}
+
+  void write(char const *data, std::size_t size) {
+    os.write(data, size);
+    offset += size;
+  }
+
+  /** \brief Add an entry which is stored without compression. */
+  void stored(std::string const &name, std::string const &data) {
+    entry e;
+    e.name = name;
+    e.flags = 0; e.method = 0; e.offset = checked(offset);
+    e.crc = crc32(crc32(0, Z_NULL, 0),
+                  reinterpret_cast<Bytef const *>(data.data()), data.size());
+    e.compressed_size = e.size = checked(data.size());
+    local_header(e);
+    write(data.data(), data.size());
+    entries.push_back(e);
+  }
+
+  /**
+   * \brief Add an entry whose data is written to the stream passed to
+   *        <code>generate</code>, and deflated on the fly.
+   */
+  template<typename Generator>
+  void deflated(std::string const &name, Generator generate);
+
+  /** \brief Write the central directory. */
+  void finish() {
+    std::uint64_t const directory = offset;
+    for (auto const &e: entries) {
+      u32(0X02014B50);
+      u16(20); u16(20); u16(e.flags); u16(e.method); u16(dos_time); u16(dos_date);
+      u32(e.crc); u32(e.compressed_size); u32(e.size);
+      u16(e.name.size()); u16(0); u16(0); u16(0); u16(0); u32(0);
+      u32(e.offset);
+      write(e.name.data(), e.name.size());
+    }
+    std::uint64_t const directory_size = offset - directory;
+    u32(0X06054B50);
+    u16(0); u16(0); u16(entries.size()); u16(entries.size());
+    u32(checked(directory_size)); u32(checked(directory));
+    u16(0);
+  }
+};
+
+/**
+ * \brief A stream buffer which raw deflates everything written to it into
+ *        a zip_writer, one buffer full at a time.
+ */
+class zip_writer::deflating_buffer : public std::streambuf {
+  zip_writer &zip;
+  z_stream z;
+  std::uint32_t crc;
+  std::uint64_t size = 0, compressed_size = 0;
+  char input[0X10000], output[0X10000];
+
+  void deflate_input(int flush) {
+    z.next_in = reinterpret_cast<Bytef *>(pbase());
+    z.avail_in = pptr() - pbase();
+    crc = crc32(crc, z.next_in, z.avail_in);
+    size += z.avail_in;
+    int status;
+    do {
+      z.next_out = reinterpret_cast<Bytef *>(output);
+      z.avail_out = sizeof(output);
+      status = ::deflate(&z, flush);
+      if (status == Z_STREAM_ERROR)
+        throw std::runtime_error("deflate failed");
+      std::size_t const produced = sizeof(output) - z.avail_out;
+      zip.write(output, produced);
+      compressed_size += produced;
+    } while (z.avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+    setp(input, input + sizeof(input));
+  }
+
+protected:
+  int_type overflow(int_type c) override {
+    deflate_input(Z_NO_FLUSH);
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+public:
+  explicit deflating_buffer(zip_writer &zip) : zip(zip) {
+    z.zalloc = Z_NULL; z.zfree = Z_NULL; z.opaque = Z_NULL;
+    if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+      throw std::runtime_error("deflateInit2 failed");
+    crc = crc32(0, Z_NULL, 0);
+    setp(input, input + sizeof(input));
+  }
+  ~deflating_buffer() { deflateEnd(&z); }
+
+  void finish(entry &e) {
+    deflate_input(Z_FINISH);
+    e.crc = crc;
+    e.size = zip.checked(size);
+    e.compressed_size = zip.checked(compressed_size);
+  }
+};
+
+template<typename Generator>
+void zip_writer::deflated(std::string const &name, Generator generate) {
+  entry e;
+  e.name = name;
+  e.flags = 1 << 3; // Sizes and checksum follow in a data descriptor.
+  e.method = 8; e.offset = checked(offset);
+  local_header(e);
+  {
+    deflating_buffer buffer { *this };
+    std::ostream stream { &buffer };
+    stream.exceptions(std::ios::badbit);
+    generate(stream);
+    buffer.finish(e);
+  }
+  u32(0X08074B50);
+  u32(e.crc); u32(e.compressed_size); u32(e.size);
+  entries.push_back(e);
+}
+
+}
+
+void compressed_musicxml(std::ostream &os, braille::ast::score const &score)
+{
+  zip_writer zip { os };
+  zip.stored("mimetype", "application/vnd.recordare.musicxml");
+  zip.stored("META-INF/container.xml",
+             "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+             "<container>\n"
+             "  <rootfiles>\n"
+             "    <rootfile full-path=\"score.xml\""
+             " media-type=\"application/vnd.recordare.musicxml+xml\"/>\n"
+             "  </rootfiles>\n"
+             "</container>\n");
+  zip.deflated("score.xml", [&score](std::ostream &xml) {
+    musicxml(xml, score);
+  });
+  zip.finish();
+}
+
+}
@@ -0,0 +1,61 @@
+// Copyright (C) 2014  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#ifndef BMC_MUSICXML_COMMON_HPP
+#define BMC_MUSICXML_COMMON_HPP
+
+#include <bmc/braille/ast.hpp>
+#include <bmc/braille/ast/visitor.hpp>
+
+namespace bmc { namespace detail {
+
+// Determine the greatest common divisor of all rhythmic values in a braille score.
+// We need this for the MusicXML divisons element.
+// We're basically determining the common denominator such that all
+// rhythmic values can be expressed as an integer, since the MusicXML duration
+// element is not a rational.
+
+class gcd_visitor : public braille::ast::const_visitor<gcd_visitor> {
+  rational value;
+public:
+  template <typename Rhythmic>
+  bool visit_rhythmic(Rhythmic const &rhythmic) {
+    value = boost::integer::gcd(value, rhythmic.as_rational());
+
+    return true;
+  }
+
+  rational const &get_result() const { return value; }
+};
+
+inline rational duration_gcd(braille::ast::score const &score) {
+  gcd_visitor accumulator;
+
+  accumulator.traverse_score(score);
+
+  return accumulator.get_result();
+}
+
+// The divisons element expresses the number of "ticks" per quarter note.
+inline rational divisions(braille::ast::score const &score) {
+  rational const result {
+    rational{1, 4} / boost::integer::gcd(duration_gcd(score), rational{1, 4})
+  };
+  BOOST_ASSERT(result.denominator() == 1);
+
+  return result;
+}
+
+inline bool is_anacrusis(braille::ast::unfolded::measure const &measure,
+                         braille::ast::score const &score) {
+  return
+  (!score.time_sigs.empty() && (duration(measure) != score.time_sigs.front())) ||
+  (score.time_sigs.empty() && duration(measure) != 1);
+}
+
+}}
+
+#endif
@@ -0,0 +1,422 @@
+// Copyright (C) 2026  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#include <bmc/musicxml.hpp>
+#include <bmc/output_buffer.hpp>
+#include "musicxml_common.hpp"
+#include <boost/variant/get.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace bmc {
+
+namespace {
+
+using detail::is_anacrusis;
+
+std::string to_string(rational const & r) {
+  return std::to_string(r.numerator()) + "/" + std::to_string(r.denominator());
+}
+
+char const *note_type(rational const &r) {
+  BOOST_ASSERT(r.numerator() == 1);
+  switch (r.denominator()) {
+  case 1: return "whole";
+  case 2: return "half";
+  case 4: return "quarter";
+  case 8: return "eighth";
+  case 16: return "16th";
+  case 32: return "32nd";
+  case 64: return "64th";
+  case 128: return "128th";
+  default: throw std::runtime_error("Unknown note type: " + to_string(r));
+  }
+}
+
+char const *accidental_value(::bmc::accidental const &a) {
+  switch (a) {
+  case ::bmc::natural: return "natural";
+  case ::bmc::flat:    return "flat";
+  case ::bmc::sharp:   return "sharp";
+  case ::bmc::double_flat: return "flat-flat";
+  case ::bmc::double_sharp: return "sharp-sharp";
+  default: throw std::runtime_error("Invalid accidental: " + std::to_string(a));
+  }
+}
+
+// The ornaments of a note, in the order the MusicXML schema wants them.
+struct ornaments {
+  unsigned trill_marks = 0, turns = 0;
+  std::vector<bool> mordents; // true for long ones
+
+  bool empty() const { return !trill_marks && !turns && mordents.empty(); }
+};
+
+class fingering_writer : public boost::static_visitor<void> {
+  output_buffer &out;
+
+public:
+  fingering_writer(output_buffer &out) : out { out } {}
+
+  void operator()(unsigned f) const {
+    out << "            <fingering>" << f << "</fingering>\n";
+  }
+  void operator()(braille::finger_change const &fc) const {
+    out << "            <fingering>" << fc.first << ' ' << fc.second
+        << "</fingering>\n";
+  }
+};
+
+/**
+ * \brief Write a score-partwise document element by element.
+ *
+ * The output is identical to what the XSD object model serializes to, but
+ * measures are written in document order straight from the unfolded parts.
+ * Staves of a multi-staff part are interleaved measure by measure, separated
+ * by backup elements.
+ */
+class musicxml_writer : public boost::static_visitor<void> {
+  output_buffer out;
+  braille::ast::score const &brl_score;
+  rational const divisions;
+  unsigned staff_number;
+
+public:
+  musicxml_writer(std::ostream &os, braille::ast::score const &score)
+  : out { os }, brl_score { score }, divisions { detail::divisions(score) }
+  , staff_number { 1 }
+  {}
+
+  void operator()() {
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" ?>\n"
+           "<!DOCTYPE score-partwise PUBLIC"
+           " \"-//Recordare//DTD MusicXML 3.0 Partwise//EN\""
+           " \"http://www.musicxml.org/dtds/partwise.dtd\">\n"
+           "<score-partwise version=\"3.0\">\n"
+           "\n"
+           "  <identification>\n"
+           "    <encoding>\n"
+           "      <software>Braille Music Compiler " BMC_VERSION "</software>\n"
+           "      <supports element=\"accidental\" type=\"yes\"/>\n"
+           "      <supports element=\"beam\" type=\"no\"/>\n"
+           "      <supports element=\"print\" type=\"no\"/>\n"
+           "      <supports element=\"stem\" type=\"no\"/>\n"
+           "      <supports element=\"transpose\" type=\"no\"/>\n"
+           "    </encoding>\n"
+           "  </identification>\n"
+           "\n"
+           "  <part-list>\n";
+    for (std::size_t c = 1; c <= brl_score.unfolded_part.size(); ++c)
+      out << "    <score-part id=\"P" << c << "\">\n"
+          << "      <part-name>Part-" << c << "</part-name>\n"
+          << "    </score-part>\n";
+    out << "  </part-list>\n";
+
+    std::size_t c { 1 };
+    for (auto &&part: brl_score.unfolded_part) {
+      out << "\n"
+          << "  <part id=\"P" << c++ << "\">\n";
+      (*this)(part);
+      out << "  </part>\n";
+    }
+    out << "\n"
+        << "</score-partwise>\n";
+  }
+
+  void operator()(braille::ast::unfolded::measure const &measure) {
+    for (auto vi = measure.voices.begin(), ve = measure.voices.end();
+         vi != ve; ++vi) {
+      for (auto &&partial_measure: *vi) {
+        for (auto pvi = partial_measure.begin(), pve = partial_measure.end();
+             pvi != pve; ++pvi) {
+          std::for_each(pvi->begin(), pvi->end(), apply_visitor(*this));
+          if (std::next(pvi) != pve) backup(braille::ast::duration(*pvi));
+        }
+      }
+      if (std::next(vi) != ve) backup(braille::ast::duration(*vi));
+    }
+  }
+  void operator()(braille::ast::key_and_time_signature const &) {
+  }
+  void operator()(braille::ast::note const &note) {
+    xml(note, boost::none);
+  }
+  void operator()(braille::ast::rest const &rest) {
+    out << "      <note>\n"
+           "        <rest/>\n";
+    duration(rest.as_rational());
+    type(rest.get_type());
+    dots(rest.get_dots());
+    staff();
+    out << "      </note>\n";
+  }
+  void operator()(braille::ast::chord const &chord) {
+    auto const arpeggio = chord.arpeggio();
+    xml(chord.base, arpeggio);
+    for (auto &&interval: chord.intervals) {
+      out << "      <note>\n"
+             "        <chord/>\n";
+      pitch(interval);
+      duration(chord.base.as_rational());
+      type(chord.base.get_type());
+      dots(chord.base.get_dots());
+      if (interval.acc) accidental(*interval.acc);
+      staff();
+      notations({}, interval.fingers, 0, arpeggio);
+      out << "      </note>\n";
+    }
+  }
+  void operator()(braille::ast::moving_note const &moving_note) {
+    xml(moving_note.base, boost::none);
+    backup(moving_note.base.as_rational());
+
+    int const count = moving_note.intervals.size();
+    for (auto &&interval: moving_note.intervals) {
+      out << "      <note>\n";
+      pitch(interval);
+      duration(moving_note.base.as_rational() / count);
+      type(moving_note.base.get_type() / count);
+      dots(moving_note.base.get_dots());
+      if (interval.acc) accidental(*interval.acc);
+      staff();
+      notations({}, interval.fingers, 0, boost::none);
+      out << "      </note>\n";
+    }
+  }
+  void operator()(braille::ast::barline const &) const {
+  }
+  void operator()(braille::ast::clef const &) const {
+  }
+  void operator()(braille::ast::hand_sign const &) const {
+  }
+  void operator()(braille::ast::tie const &) const {
+  }
+
+private:
+  typedef boost::optional<braille::ast::chord::arpeggio_type> arpeggio_type;
+
+  void operator()(braille::ast::unfolded::part const &part) {
+    BOOST_ASSERT(!part.empty());
+
+    // Key and time signature changes are not exported, skip them.
+    std::vector<std::vector<braille::ast::unfolded::measure const *>> staves;
+    std::size_t measure_count { 1 };
+    for (auto &&staff: part) {
+      staves.emplace_back();
+      for (auto &&element: staff) {
+        if (auto measure = boost::get<braille::ast::unfolded::measure>(&element))
+          staves.back().push_back(measure);
+      }
+      measure_count = std::max(measure_count, staves.back().size());
+    }
+
+    for (std::size_t index = 0; index < measure_count; ++index) {
+      if (index == 0) {
+        bool implicit = false;
+        for (auto &&measures: staves)
+          if (!measures.empty() && is_anacrusis(*measures.front(), brl_score))
+            implicit = true;
+        bool const starts_with_anacrusis = !staves.front().empty() &&
+          is_anacrusis(*staves.front().front(), brl_score);
+        out << "    <measure ";
+        if (implicit) out << "implicit=\"yes\" ";
+        out << "number=\"" << (starts_with_anacrusis? "0": "1") << "\">\n";
+        attributes(part.size());
+      } else {
+        // The first staff to get this far determines the measure number.
+        for (auto &&measures: staves) {
+          if (index < measures.size()) {
+            bool const implicit = is_anacrusis(*measures.front(), brl_score);
+            out << "    <measure number=\"" << (implicit? index: index + 1)
+                << "\">\n";
+            break;
+          }
+        }
+      }
+
+      for (staff_number = 1; staff_number <= staves.size(); ++staff_number) {
+        auto const &measures = staves[staff_number - 1];
+        if (index < measures.size()) {
+          if (staff_number > 1) backup(braille::ast::duration(*measures[index]));
+          (*this)(*measures[index]);
+        }
+      }
+      out << "    </measure>\n";
+    }
+  }
+
+  void attributes(std::size_t staves) {
+    out << "      <attributes>\n"
+           "        <divisions>";
+    decimal(divisions);
+    out << "</divisions>\n"
+           "        <key>\n"
+           "          <fifths>" << int(brl_score.key_sig) << "</fifths>\n"
+           "        </key>\n";
+    if (!brl_score.time_sigs.empty()) {
+      auto const &time = brl_score.time_sigs.front();
+      out << "        <time>\n"
+             "          <beats>" << time.numerator() << "</beats>\n"
+             "          <beat-type>" << time.denominator() << "</beat-type>\n"
+             "        </time>\n";
+    }
+    out << "        <staves>" << staves << "</staves>\n"
+           "      </attributes>\n";
+  }
+
+  void xml(braille::ast::note const &note, arpeggio_type const &arpeggio) {
+    bool const grace = is_grace(note);
+    out << "      <note>\n";
+    if (grace) out << "        <grace/>\n";
+    pitch(note);
+    if (!grace) duration(note.as_rational());
+    if (note.get_type() != zero) type(note.get_type());
+    dots(note.get_dots());
+    if (note.acc) accidental(*note.acc);
+    staff();
+
+    ornaments ornaments;
+    unsigned staccatos = 0;
+    for (auto &&articulation: note.articulations) {
+      switch(articulation) {
+      default: throw std::runtime_error("Unknown articulation: " + std::to_string(articulation));
+      case appoggiatura: // Handled by is_grace().
+      case arpeggio_up: // Handled by arpeggio() method of ast::chord
+      case arpeggio_down:
+        break;
+      case extended_mordent:
+        ornaments.mordents.push_back(true);
+        break;
+      case mordent:
+        ornaments.mordents.push_back(false);
+        break;
+      case extended_short_trill:
+      case short_trill:
+        ornaments.trill_marks += 1;
+        break;
+      case staccato:
+        staccatos += 1;
+        break;
+      case turn_between_notes:
+      case turn_above_or_below_note:
+        ornaments.turns += 1;
+        break;
+      }
+    }
+    notations(ornaments, note.fingers, staccatos, arpeggio);
+    out << "      </note>\n";
+  }
+
+  void notations(ornaments const &ornaments,
+                 braille::fingering_list const &fingers,
+                 unsigned staccatos,
+                 arpeggio_type const &arpeggio) {
+    if (ornaments.empty() && fingers.empty() && !staccatos && !arpeggio)
+      return;
+
+    out << "        <notations>\n";
+    if (!ornaments.empty()) {
+      out << "          <ornaments>\n";
+      for (unsigned i = 0; i < ornaments.trill_marks; ++i)
+        out << "            <trill-mark/>\n";
+      for (unsigned i = 0; i < ornaments.turns; ++i)
+        out << "            <turn/>\n";
+      for (bool long_: ornaments.mordents)
+        out << (long_? "            <mordent long=\"yes\"/>\n"
+                     : "            <mordent/>\n");
+      out << "          </ornaments>\n";
+    }
+    if (!fingers.empty()) {
+      out << "          <technical>\n";
+      fingering_writer const write_to_buffer { out };
+      std::for_each(fingers.begin(), fingers.end(),
+                    apply_visitor(write_to_buffer));
+      out << "          </technical>\n";
+    }
+    if (staccatos) {
+      out << "          <articulations>\n";
+      for (unsigned i = 0; i < staccatos; ++i)
+        out << "            <staccato/>\n";
+      out << "          </articulations>\n";
+    }
+    if (arpeggio) {
+      switch (*arpeggio) {
+      default: throw std::runtime_error("Unknown arpeggio_type.");
+      case braille::ast::chord::arpeggio_type::up:
+        out << "          <arpeggiate direction=\"up\"/>\n";
+        break;
+      case braille::ast::chord::arpeggio_type::down:
+        out << "          <arpeggiate direction=\"down\"/>\n";
+        break;
+      }
+    }
+    out << "        </notations>\n";
+  }
+
+  void pitch(braille::ast::pitched const &p) {
+    static char const steps[] = "CDEFGAB";
+    out << "        <pitch>\n"
+           "          <step>" << steps[p.step] << "</step>\n";
+    if (p.alter) out << "          <alter>" << p.alter << "</alter>\n";
+    out << "          <octave>" << int(p.octave) - 1 << "</octave>\n"
+           "        </pitch>\n";
+  }
+
+  void duration(rational const &dur) {
+    out << "        <duration>";
+    decimal(dur / (rational{1, 4} / divisions));
+    out << "</duration>\n";
+  }
+
+  void backup(rational const &dur) {
+    out << "      <backup>\n";
+    duration(dur);
+    out << "      </backup>\n";
+  }
+
+  void type(rational const &r) {
+    out << "        <type>" << note_type(r) << "</type>\n";
+  }
+
+  void dots(unsigned count) {
+    for (unsigned i = 0; i < count; ++i) out << "        <dot/>\n";
+  }
+
+  void accidental(::bmc::accidental const &a) {
+    out << "        <accidental>" << accidental_value(a) << "</accidental>\n";
+  }
+
+  void staff() {
+    out << "        <staff>" << staff_number << "</staff>\n";
+  }
+
+  // Like xsd:decimal, without trailing zeros.
+  void decimal(rational const &value) {
+    if (value.denominator() == 1) {
+      out << value.numerator();
+    } else {
+      char digits[64];
+      int length = std::snprintf(digits, sizeof(digits), "%.15f",
+                                 boost::rational_cast<double>(value));
+      while (digits[length - 1] == '0') --length;
+      if (digits[length - 1] == '.') --length;
+      digits[length] = '\0';
+      out << digits;
+    }
+  }
+};
+
+}
+
+void musicxml(::std::ostream &os, braille::ast::score const &score)
+{
+  musicxml_writer generate { os, score };
+  generate();
+}
+
+}
@@ -5,11 +5,16 @@
 //  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
 
 #include "numbers_def.hpp"
+#include "bmc/braille/parsing/iterator.hpp"
 
 namespace bmc { namespace braille {
 
 typedef std::wstring::const_iterator iterator_type;
 template struct upper_number_grammar<iterator_type>;
 template struct lower_number_grammar<iterator_type>;
+template struct upper_number_grammar<utf8_iterator>;
+template struct lower_number_grammar<utf8_iterator>;
+template struct upper_number_grammar<utf32_iterator>;
+template struct lower_number_grammar<utf32_iterator>;
 
 }}
@@ -12,6 +12,7 @@
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include "brlsym.hpp"
 #include <bmc/braille/parsing/qi/primitive/brl.hpp>
+#include <bmc/braille/parsing/profile.hpp>
 
 namespace bmc { namespace braille {
 
@@ -24,6 +25,8 @@ upper_number_grammar<Iterator>::upper_number_grammar()
   boost::spirit::qi::_val_type _val;
 
   start = eps[_val = 0] >> +upper_digit_sign[_val = _val * 10 + _1];
+
+  BMC_PROFILE_RULES("upper_number", (start))
 }
 
 template <typename Iterator>
@@ -35,6 +38,8 @@ lower_number_grammar<Iterator>::lower_number_grammar()
   boost::spirit::qi::_val_type _val;
 
   start = eps[_val = 0] >> +lower_digit_sign[_val = _val * 10 + _1];
+
+  BMC_PROFILE_RULES("lower_number", (start))
 }
 
 }}
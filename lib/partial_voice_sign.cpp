@@ -5,10 +5,13 @@
 //  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
 
 #include "partial_voice_sign_def.hpp"
+#include "bmc/braille/parsing/iterator.hpp"
 
 namespace bmc { namespace braille {
 
 typedef std::wstring::const_iterator iterator_type;
 template struct partial_voice_sign_grammar<iterator_type>;
+template struct partial_voice_sign_grammar<utf8_iterator>;
+template struct partial_voice_sign_grammar<utf32_iterator>;
 
 }}
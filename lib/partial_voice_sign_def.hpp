@@ -11,7 +11,9 @@
 #include <bmc/braille/ast/fusion_adapt.hpp>
 #include <bmc/braille/parsing/qi/primitive/brl.hpp>
 #include "brlsym.hpp"
+#include "spirit/detail/move_into_container.hpp"
 #include <bmc/braille/parsing/error_handler.hpp>
+#include <bmc/braille/parsing/profile.hpp>
 #include <bmc/braille/parsing/annotation.hpp>
 #include <boost/spirit/include/qi_core.hpp>
 #include <boost/spirit/include/qi_attr.hpp>
@@ -28,6 +30,61 @@
 
 namespace bmc { namespace braille {
 
+/**
+ * \brief Complete a sign which begins with a note.
+ *
+ * Chords and moving notes start with a complete note.  The note is parsed
+ * only once, and moved into the chord, the moving note or the sign itself,
+ * depending on what follows it.
+ */
+struct make_note_sign
+{
+  template <typename>
+  struct result { typedef void type; };
+
+  void operator()(ast::sign &sign, ast::note &note) const
+  { sign = std::move(note); }
+
+  void operator()( ast::sign &sign, ast::note &note
+                 , std::vector<ast::interval> &intervals
+                 ) const
+  {
+    ast::moving_note moving_note;
+    moving_note.base = std::move(note);
+    moving_note.intervals = std::move(intervals);
+    sign = std::move(moving_note);
+  }
+
+  void operator()( ast::sign &sign, ast::note &note
+                 , std::vector<ast::interval> &intervals, bool all_tied
+                 ) const
+  {
+    ast::chord chord;
+    chord.base = std::move(note);
+    chord.intervals = std::move(intervals);
+    chord.all_tied = all_tied;
+    sign = std::move(chord);
+  }
+};
+
+/**
+ * \brief Annotate the chord a sign holds, if any.
+ *
+ * A chord spans its base note and all of its intervals, so its range is
+ * only known once the whole sign has been parsed.
+ */
+template <typename Iterator>
+struct chord_annotation : annotation<Iterator>
+{
+  using annotation<Iterator>::annotation;
+
+  void operator()(ast::sign &sign, Iterator begin, Iterator end) const
+  {
+    if (auto chord = boost::get<ast::chord>(&sign))
+      annotation<Iterator>::operator()(*chord, begin, end);
+  }
+};
+
 template<typename Iterator>
 partial_voice_sign_grammar<Iterator>::partial_voice_sign_grammar(error_handler<Iterator>& error_handler)
 : partial_voice_sign_grammar::base_type(start, "partial_voice_sign")
@@ -40,18 +97,25 @@ partial_voice_sign_grammar<Iterator>::partial_voice_sign_grammar(error_handler<I
 
   typedef boost::phoenix::function< annotation<Iterator> >
           annotation_function;
+  typedef boost::phoenix::function< chord_annotation<Iterator> >
+          chord_annotation_function;
+  boost::phoenix::function<make_note_sign> const make_sign;
+  boost::phoenix::function<move_assign> const move_to;
 
   ::bmc::braille::brl_type brl;
   boost::spirit::_1_type _1;
+  boost::spirit::_2_type _2;
   boost::spirit::_3_type _3;
   boost::spirit::_val_type _val;
+  boost::spirit::_a_type _a;
   boost::spirit::attr_type attr;
+  boost::spirit::eps_type eps;
   boost::spirit::matches_type matches;
   boost::spirit::repeat_type repeat;
   using boost::phoenix::at_c;
 
   start = hyphen
-        | moving_note | chord | note | rest
+        | note_or_chord | rest
         | value_prefix | tie | tuplet_start
         | clef | hand_sign
         | simile
@@ -77,8 +141,13 @@ partial_voice_sign_grammar<Iterator>::partial_voice_sign_grammar(error_handler<I
   rest = added_by_transcriber >> rest_sign >> dots >> -(brl(5) >> brl(14));
 
   chord_tied_sign = brl(46) >> brl(14);
-  chord = note >> +interval >> (chord_tied_sign >> attr(true) | attr(false));
-  moving_note = note >> moving_intervals;
+  note_or_chord =
+       note                                           [move_to(_a, _1)]
+    >> ( moving_intervals                             [make_sign(_val, _a, _1)]
+       | (+interval >> (chord_tied_sign >> attr(true) | attr(false)))
+                                                      [make_sign(_val, _a, _1, _2)]
+       | eps                                          [make_sign(_val, _a)]
+       );
   moving_intervals = +(interval >> brl(6)) >> interval;
   interval = -accidental_sign
           >> -octave_sign
@@ -110,7 +179,6 @@ partial_voice_sign_grammar<Iterator>::partial_voice_sign_grammar(error_handler<I
   fingering = *(finger_change | finger_sign);
 
   boost::spirit::eol_type eol;
-  boost::spirit::eps_type eps;
   simple_tie = brl(4) >> brl(14) >> attr(ast::tie::single);
 
   dots = eps[_val = 0] >> *(brl(3)[_val += 1]);
@@ -139,24 +207,33 @@ partial_voice_sign_grammar<Iterator>::partial_voice_sign_grammar(error_handler<I
   hyphen = brl(5) >> eol;
 #define BMC_LOCATABLE_SET_ID(rule) \
   boost::spirit::qi::on_success(rule,\
-                                annotation_function(error_handler.ranges)\
+                                annotation_function(error_handler)\
                                 (_val, _1, _3))
   BMC_LOCATABLE_SET_ID(note);
   BMC_LOCATABLE_SET_ID(rest);
   BMC_LOCATABLE_SET_ID(interval);
-  BMC_LOCATABLE_SET_ID(chord);
   BMC_LOCATABLE_SET_ID(value_prefix);
   BMC_LOCATABLE_SET_ID(hyphen);
   BMC_LOCATABLE_SET_ID(tie);
   BMC_LOCATABLE_SET_ID(clef);
   BMC_LOCATABLE_SET_ID(hand_sign);
 #undef BMC_LOCATABLE_SET_ID
+  boost::spirit::qi::on_success(note_or_chord,
+                                chord_annotation_function(error_handler)
+                                (_val, _1, _3));
   
   clef.name("clef");
   note.name("note");
   interval.name("interval");
   fingering.name("fingering");
   optional_dot.name(".");
+
+  BMC_PROFILE_RULES("partial_voice_sign",
+    (start)(note)(stem)(added_by_transcriber)(rest)(note_or_chord)
+    (moving_intervals)(interval)(finger_sign)(finger_change)(fingering)
+    (hand_sign)(clef)(dots)(slur)(tie)(simple_tie)(chord_tied_sign)
+    (value_prefix)(hyphen)(optional_dot)
+  )
 }
 
 }}
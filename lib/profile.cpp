@@ -0,0 +1,59 @@
+// Copyright (C) 2026  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#include "bmc/braille/parsing/profile.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+
+namespace bmc { namespace braille {
+
+namespace {
+
+std::mutex profiles_mutex;
+std::map<std::string, rule_profile> profiles;
+
+}
+
+rule_profile &profiled_rule(std::string const &name)
+{
+  std::lock_guard<std::mutex> lock(profiles_mutex);
+  return profiles[name];
+}
+
+void write_grammar_profile(std::ostream &os)
+{
+  std::vector<std::pair<std::string const *, rule_profile const *>> rules;
+  {
+    std::lock_guard<std::mutex> lock(profiles_mutex);
+    for (auto const &rule: profiles) rules.emplace_back(&rule.first, &rule.second);
+  }
+  std::stable_sort(rules.begin(), rules.end(),
+                   [](std::pair<std::string const *, rule_profile const *> const &lhs,
+                      std::pair<std::string const *, rule_profile const *> const &rhs) {
+                     return lhs.second->entered > rhs.second->entered;
+                   });
+
+  os << std::left << std::setw(40) << "rule" << std::right
+     << std::setw(12) << "entered" << std::setw(12) << "succeeded"
+     << std::setw(12) << "failed" << std::setw(16) << "consumed/fail"
+     << '\n';
+  for (auto const &rule: rules) {
+    std::uint64_t const failed = rule.second->failed;
+    os << std::left << std::setw(40) << *rule.first << std::right
+       << std::setw(12) << rule.second->entered
+       << std::setw(12) << rule.second->succeeded
+       << std::setw(12) << failed
+       << std::setw(16) << std::fixed << std::setprecision(2)
+       << (failed? double(rule.second->consumed_before_failure) / failed: 0.0)
+       << '\n';
+  }
+}
+
+}}
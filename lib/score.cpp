@@ -5,10 +5,26 @@
 //  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
 
 #include "score_def.hpp"
+#include "bmc/braille/parsing/iterator.hpp"
 
 namespace bmc { namespace braille {
 
 typedef std::wstring::const_iterator iterator_type;
 template struct score_grammar<iterator_type>;
+template struct score_grammar<utf8_iterator>;
+template struct score_grammar<utf32_iterator>;
+
+template bool parse_score(iterator_type &, iterator_type,
+                          error_handler<iterator_type> &, ast::score &,
+                          braille_table const &, unsigned,
+                          section_pipeline const &);
+template bool parse_score(utf8_iterator &, utf8_iterator,
+                          error_handler<utf8_iterator> &, ast::score &,
+                          braille_table const &, unsigned,
+                          section_pipeline const &);
+template bool parse_score(utf32_iterator &, utf32_iterator,
+                          error_handler<utf32_iterator> &, ast::score &,
+                          braille_table const &, unsigned,
+                          section_pipeline const &);
 
 }}
@@ -10,6 +10,7 @@
 #include <bmc/braille/parsing/grammar/score.hpp>
 #include <bmc/braille/ast/fusion_adapt.hpp>
 #include <bmc/braille/parsing/annotation.hpp>
+#include <bmc/braille/parsing/profile.hpp>
 #include <bmc/braille/parsing/qi/primitive/brl.hpp>
 #include "brlsym.hpp"
 #include <boost/spirit/include/qi_core.hpp>
@@ -22,17 +23,70 @@
 #include <boost/spirit/include/phoenix_fusion.hpp>
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include <boost/spirit/include/phoenix_statement.hpp>
+#include <atomic>
+#include <future>
+#include <iterator>
+#include <boost/spirit/include/qi_parse.hpp>
+#include <bmc/braille/ast/visitor.hpp>
 #include "spirit/detail/info_wchar_t_io.hpp"
+#include "spirit/detail/move_into_container.hpp"
 
 namespace bmc { namespace braille {
 
+namespace detail {
+
+template <typename Iterator>
+struct recovering
+{
+  typedef bool result_type;
+
+  error_handler<Iterator> &handler;
+
+  bool operator()() const { return handler.target().recover; }
+};
+
+/**
+ * \brief Turn expectation failures into plain failures while recovering
+ *        from parse errors, so that an ast::unparsable node is parsed instead.
+ */
+template <typename Iterator>
+struct fail_if_recovering
+{
+  error_handler<Iterator> &handler;
+
+  template <typename Params, typename Context>
+  void operator()( Params const &, Context &
+                 , boost::spirit::qi::error_handler_result &result
+                 ) const
+  {
+    if (!handler.target().recover) result = boost::spirit::qi::rethrow;
+  }
+};
+
+struct append_section
+{
+  template <typename>
+  struct result { typedef void type; };
+
+  void operator()(section_list &sections, section_kind kind,
+                  ast::section &section) const
+  { sections.emplace_back(kind, std::move(section)); }
+};
+
+}
+
 template<typename Iterator>
 score_grammar<Iterator>::score_grammar(error_handler<Iterator>& error_handler)
 : score_grammar::base_type(start, "score")
 , measure(error_handler)
+, errors(error_handler)
 {
   using boost::phoenix::at_c;
-  using boost::phoenix::push_back;
+  typedef boost::phoenix::function<braille::move_back> move_back_function;
+  move_back_function const move_back;
+  boost::phoenix::function<detail::append_section> const append_section;
+  boost::phoenix::function< detail::recovering<Iterator> > const
+  recovering(detail::recovering<Iterator>{error_handler});
   typedef boost::phoenix::function< annotation<Iterator> >
           annotation_function;
   typedef boost::phoenix::function< braille::error_handler<Iterator> >
@@ -40,6 +94,8 @@ score_grammar<Iterator>::score_grammar(error_handler<Iterator>& error_handler)
   boost::spirit::qi::eoi_type eoi;
   boost::spirit::qi::eol_type eol;
   boost::spirit::qi::eps_type eps;
+  boost::spirit::qi::omit_type omit;
+  boost::spirit::standard_wide::char_type char_;
   boost::spirit::qi::_1_type _1;
   boost::spirit::qi::_3_type _3;
   boost::spirit::qi::_4_type _4;
@@ -50,26 +106,39 @@ score_grammar<Iterator>::score_grammar(error_handler<Iterator>& error_handler)
   whitespace = blank | brl(0);
   indent = whitespace >> +whitespace;
 
-  start = *whitespace
-       >> key_signature
-       >> -whitespace
-       >> -(time_signature % (brl(5)>>brl(2)))
-       >> *whitespace
-       >> -+eol
-       >> +(keyboard_part | solo_part)
+  start = head[_val = _1]
+       >> +(keyboard_part | solo_part)[move_back(at_c<2>(_val), _1)]
         ;
 
+  head = *whitespace
+      >> key_signature[at_c<0>(_val) = _1]
+      >> -whitespace
+      >> -(time_signature % (brl(5)>>brl(2)))[at_c<1>(_val) = _1]
+      >> *whitespace
+      >> -+eol
+       ;
+
+  // The alternatives are tried in the same order as keyboard_part and
+  // solo_part try them, so a sequence of sections is recognized just like
+  // it would be as part of a whole score.
+  sections =
+    *( keyboard_section[append_section(_val, section_kind::keyboard, _1)]
+     | last_keyboard_section[append_section(_val, section_kind::last_keyboard, _1)]
+     | solo_section[append_section(_val, section_kind::solo, _1)]
+     | last_solo_section[append_section(_val, section_kind::last_solo, _1)]
+     );
+
   keyboard_section =
        (-(*whitespace >> key_and_time_signature >> *whitespace >> eol))[at_c<0>(_val) = _1]
     >> indent
     >> -section_number[at_c<1>(_val) = _1]
     >> -measure_range[at_c<2>(_val) = _1]
     >> right_hand_sign
-    >> paragraph[push_back(at_c<3>(_val), _1)]
+    >> paragraph[move_back(at_c<3>(_val), _1)]
     >> eol
     >> indent
     >> left_hand_sign
-    >> paragraph[push_back(at_c<3>(_val), _1)]
+    >> paragraph[move_back(at_c<3>(_val), _1)]
     >> eol
       ;
 
@@ -79,12 +148,12 @@ score_grammar<Iterator>::score_grammar(error_handler<Iterator>& error_handler)
     >> -section_number[at_c<1>(_val) = _1]
     >> -measure_range[at_c<2>(_val) = _1]
     >> right_hand_sign
-    >> paragraph[push_back(at_c<3>(_val), _1)]
+    >> paragraph[move_back(at_c<3>(_val), _1)]
     >> eom
     >> eol
     >> indent
     >> left_hand_sign
-    >> paragraph[push_back(at_c<3>(_val), _1)]
+    >> paragraph[move_back(at_c<3>(_val), _1)]
     >> eom
     >> (eoi | +eol)
      ;
@@ -112,7 +181,29 @@ score_grammar<Iterator>::score_grammar(error_handler<Iterator>& error_handler)
 
   solo_part = *solo_section >> last_solo_section;
 
-  paragraph = (key_and_time_signature | measure) % (whitespace | eol);
+  paragraph = paragraph_element % (whitespace | eol);
+
+  // Unless recovering from a parse error, a measure which is not followed by
+  // whitespace or the end of its line is left to the rules using paragraph,
+  // which will fail.  While recovering, everything up to there is skipped.
+  paragraph_element = key_and_time_signature
+                    | recoverable_measure >> (!eps(recovering()) | &element_end)
+                    | unparsable
+                    ;
+  recoverable_measure = measure;
+  element_end = whitespace | eol | eom | eoi;
+  unparsable = eps(recovering())
+            >> !section_start
+            >> omit[+(char_ - element_end)]
+             ;
+  // A line starting like this begins a new section, it does not continue the
+  // paragraph before it.
+  section_start =
+       brl(3456)
+    >> ( (upper_number >> whitespace)
+       | (lower_number >> -(brl(3456) >> lower_number) >> brl(36))
+       )
+     ;
 
   section_number = brl(3456) >> upper_number >> whitespace;
   measure_range =
@@ -132,7 +223,7 @@ score_grammar<Iterator>::score_grammar(error_handler<Iterator>& error_handler)
 
 #define BMC_LOCATABLE_SET_ID(rule) \
   boost::spirit::qi::on_success(rule,\
-                                annotation_function(error_handler.ranges)\
+                                annotation_function(error_handler)\
                                 (_val, _1, _3))
   BMC_LOCATABLE_SET_ID(measure_specification);
   BMC_LOCATABLE_SET_ID(measure_range);
@@ -140,10 +231,302 @@ score_grammar<Iterator>::score_grammar(error_handler<Iterator>& error_handler)
   BMC_LOCATABLE_SET_ID(last_keyboard_section);
   BMC_LOCATABLE_SET_ID(solo_section);
   BMC_LOCATABLE_SET_ID(last_solo_section);
+  BMC_LOCATABLE_SET_ID(unparsable);
 
   const wchar_t *prefix = L"error: expecting ";
   boost::spirit::qi::on_error<boost::spirit::qi::fail>(start,
     error_handler_function(error_handler)(prefix, _4, _3));
+  boost::spirit::qi::on_error<boost::spirit::qi::fail>(recoverable_measure,
+    detail::fail_if_recovering<Iterator>{error_handler});
+
+  BMC_PROFILE_RULES("score",
+    (start)(head)(sections)(solo_part)(keyboard_part)
+    (keyboard_section)(last_keyboard_section)(solo_section)(last_solo_section)
+    (paragraph)(paragraph_element)(recoverable_measure)(unparsable)
+    (section_number)(measure_range)(measure_specification)
+    (key_and_time_signature)(right_hand_sign)(left_hand_sign)(eom)
+    (optional_dot)(whitespace)(indent)(element_end)(section_start)
+  )
+}
+
+template<typename Iterator>
+void score_grammar<Iterator>::report_unparsable(ast::score const &score) const
+{
+  namespace qi = boost::spirit::qi;
+  braille::error_handler<Iterator> &handler = errors.target();
+  for (ast::part const &part: score.parts) {
+    for (ast::section const &section: part) {
+      for (ast::paragraph const &paragraph: section.paragraphs) {
+        for (ast::paragraph_element const &element: paragraph) {
+          if (ast::unparsable const *unparsable =
+              boost::get<ast::unparsable>(&element)) {
+            // Parse the measure again to find out where exactly it went wrong.
+            auto const range = handler.range(unparsable->id);
+            Iterator iter = range.begin();
+            try {
+              qi::parse(iter, range.end(), measure);
+              handler(L"error", L"unexpected sign", iter);
+            } catch (qi::expectation_failure<Iterator> const &failure) {
+              handler(L"error: expecting ", failure.what_, failure.first);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+namespace detail {
+
+/**
+ * \brief Shift the ids of all annotated nodes of a section by a fixed offset.
+ */
+class id_offset : public ast::visitor<id_offset>
+{
+  int offset;
+
+  void shift(ast::locatable &node) const
+  { if (node.id >= 0) node.id += offset; }
+
+  void shift_tie(ast::pitched &pitched) const
+  { if (pitched.tie) shift(*pitched.tie); }
+
+public:
+  id_offset(int offset) : offset(offset) {}
+
+  bool visit_section(ast::section &section) {
+    shift(section);
+    if (section.key_and_time_sig) shift(*section.key_and_time_sig);
+    if (section.range) {
+      shift(*section.range);
+      shift(section.range->first);
+      shift(section.range->last);
+    }
+    return true;
+  }
+  bool visit_key_and_time_signature(ast::key_and_time_signature &kt)
+  { shift(kt); return true; }
+  bool walk_up_from_locatable(ast::locatable &node)
+  { shift(node); return true; }
+  bool visit_pitched(ast::pitched &pitched)
+  { shift_tie(pitched); return true; }
+  bool visit_note(ast::note &note) {
+    for (auto &stem: note.extra_stems) if (stem.tied) shift(*stem.tied);
+    return true;
+  }
+  bool visit_interval(ast::interval &interval)
+  { shift(interval); shift_tie(interval); return true; }
+  bool visit_value_prefix(ast::value_prefix &v) { shift(v); return true; }
+  bool visit_hyphen(ast::hyphen &h) { shift(h); return true; }
+  bool visit_tie(ast::tie &t) { shift(t); return true; }
+  bool visit_tuplet_start(ast::tuplet_start &t) { shift(t); return true; }
+  bool visit_clef(ast::clef &c) { shift(c); return true; }
+  bool visit_simile(ast::simile &s) { shift(s); return true; }
+  bool visit_hand_sign(ast::hand_sign &h) { shift(h); return true; }
+};
+
+/**
+ * \brief A run of sections parsed independently of the rest of the input.
+ */
+template <typename Iterator>
+struct section_run
+{
+  Iterator first, last;
+  error_handler<Iterator> errors;
+  section_list sections;
+  bool parsed = false;
+  std::promise<void> done;
+
+  section_run(Iterator first, Iterator last)
+  : first(first), last(last), errors(first, last)
+  {}
+
+  void parse(score_grammar<Iterator> const &grammar, braille_table const &table)
+  {
+    typename error_handler<Iterator>::scope const scope(errors);
+    braille_table::scope const table_scope(table);
+    Iterator iter = first;
+    try {
+      parsed = boost::spirit::qi::parse(iter, last, grammar.sections, sections)
+            && iter == last;
+    } catch (boost::spirit::qi::expectation_failure<Iterator> const &) {
+      parsed = false;
+    } catch (...) {
+      done.set_exception(std::current_exception());
+      return;
+    }
+    done.set_value();
+  }
+};
+
+/**
+ * \brief Characters of input below which splitting it is not worth it.
+ */
+constexpr std::size_t section_run_size = 0X8000;
+
+}
+
+template<typename Iterator>
+bool parse_score( Iterator &first, Iterator last
+                , error_handler<Iterator> &error_handler
+                , ast::score &score
+                , braille_table const &table
+                , unsigned jobs
+                , section_pipeline const &pipeline
+                )
+{
+  namespace qi = boost::spirit::qi;
+  static score_parser<Iterator> const parser;
+  score_grammar<Iterator> const &grammar = parser.grammar;
+  typename braille::error_handler<Iterator>::scope const scope(error_handler);
+  braille_table::scope const table_scope(table);
+  auto const sequentially = [&]() {
+    return parser(first, last, error_handler, score, table);
+  };
+
+  std::size_t const size = std::distance(first, last);
+  if (size < 2 * detail::section_run_size) return sequentially();
+
+  std::size_t const ranges = error_handler.ranges.size();
+  auto const fall_back = [&]() {
+    score = ast::score();
+    error_handler.ranges.resize(ranges);
+    return sequentially();
+  };
+
+  Iterator iter = first;
+  try {
+    if (!qi::parse(iter, last, grammar.head, score)) return fall_back();
+  } catch (qi::expectation_failure<Iterator> const &) {
+    return fall_back();
+  }
+
+  // A line can only start a new run of sections if it can not continue the
+  // section of the previous line, neither as part of the same paragraph nor
+  // as the left hand paragraph of a keyboard section.  Whatever the probes
+  // annotate is discarded again.
+  auto const continues_section = [&](Iterator const &line) {
+    bool continues = false;
+    try {
+      Iterator i = line;
+      continues = qi::parse(i, last, grammar.key_and_time_signature);
+      i = line;
+      continues = continues || qi::parse(i, last, grammar.measure);
+      i = line;
+      continues = continues ||
+                  qi::parse(i, last, grammar.indent >> grammar.left_hand_sign);
+    } catch (qi::expectation_failure<Iterator> const &) {
+      continues = true;
+    }
+    error_handler.ranges.resize(ranges);
+    return continues;
+  };
+
+  std::vector<detail::section_run<Iterator>> runs;
+  {
+    Iterator run_start = iter;
+    std::size_t length = 0;
+    bool line_start = false;
+    for (; iter != last; ++iter, ++length) {
+      if (line_start && length >= detail::section_run_size &&
+          *iter != '\r' && *iter != '\n' && !continues_section(iter)) {
+        runs.emplace_back(run_start, iter);
+        run_start = iter;
+        length = 0;
+      }
+      line_start = *iter == '\n';
+    }
+    runs.emplace_back(run_start, last);
+  }
+  if (runs.size() == 1) return fall_back();
+
+  // Worker threads parse the runs, while this thread merges them in input
+  // order as soon as they are done, and passes their sections on to the
+  // pipeline.  The sections stay in their runs until the pipeline has
+  // finished with them.
+  std::atomic<std::size_t> next { 0 };
+  auto const worker = [&]() {
+    for (std::size_t i = next++; i < runs.size(); i = next++)
+      runs[i].parse(grammar, table);
+  };
+  std::size_t const threads =
+    std::min<std::size_t>(std::max(jobs, 1U), runs.size());
+  std::vector<std::future<void>> workers;
+  for (std::size_t i = 0; i < threads; ++i)
+    workers.push_back(std::async(std::launch::async, worker));
+
+  bool finished = !pipeline.finish;
+  auto const finish = [&](bool parsed) {
+    if (!finished) {
+      finished = true;
+      pipeline.finish(parsed);
+    }
+  };
+  auto const abandon = [&]() {
+    next = runs.size();
+    finish(false);
+    return fall_back();
+  };
+
+  std::size_t parts = 0;
+  bool in_part = false, keyboard = false;
+  try {
+    for (auto &run: runs) {
+      run.done.get_future().get();
+      if (!run.parsed) return abandon();
+
+      detail::id_offset renumber(error_handler.ranges.size());
+      std::uint32_t const run_offset =
+        detail::code_units<Iterator>::distance(error_handler.first, run.first);
+      for (source_range range: run.errors.ranges) {
+        range.offset += run_offset;
+        error_handler.ranges.push_back(range);
+      }
+      error_handler.messages->insert(error_handler.messages->end(),
+                                     run.errors.messages->begin(),
+                                     run.errors.messages->end());
+
+      for (auto &kind_and_section: run.sections) {
+        bool const keyboard_section =
+          kind_and_section.first == section_kind::keyboard ||
+          kind_and_section.first == section_kind::last_keyboard;
+        if (!in_part) keyboard = keyboard_section;
+        else if (keyboard != keyboard_section) return abandon();
+        in_part = true;
+
+        renumber.traverse_section(kind_and_section.second);
+        if (pipeline.section)
+          pipeline.section(score, kind_and_section.first,
+                           kind_and_section.second);
+        if (kind_and_section.first == section_kind::last_keyboard ||
+            kind_and_section.first == section_kind::last_solo) {
+          in_part = false;
+          ++parts;
+        }
+      }
+    }
+  } catch (...) {
+    next = runs.size();
+    finish(false);
+    throw;
+  }
+  if (in_part || parts == 0) return abandon();
+  finish(true);
+
+  ast::part part;
+  for (auto &run: runs) {
+    for (auto &kind_and_section: run.sections) {
+      part.push_back(std::move(kind_and_section.second));
+      if (kind_and_section.first == section_kind::last_keyboard ||
+          kind_and_section.first == section_kind::last_solo) {
+        score.parts.push_back(std::move(part));
+        part.clear();
+      }
+    }
+  }
+
+  first = last;
+  return true;
 }
 
 }}
@@ -13,6 +13,7 @@
 #include "brlsym.hpp"
 #include <bmc/braille/parsing/error_handler.hpp>
 #include <bmc/braille/parsing/annotation.hpp>
+#include <bmc/braille/parsing/profile.hpp>
 #include <boost/spirit/include/qi_core.hpp>
 #include <boost/spirit/include/qi_eps.hpp>
 #include <boost/spirit/include/qi_optional.hpp>
@@ -48,10 +49,12 @@ simile_grammar<Iterator>::simile_grammar(error_handler<Iterator>& error_handler)
 
 #define BMC_LOCATABLE_SET_ID(rule) \
   boost::spirit::qi::on_success(rule,\
-                                annotation_function(error_handler.ranges)\
+                                annotation_function(error_handler)\
                                 (_val, _1, _3))
   BMC_LOCATABLE_SET_ID(start);
 #undef BMC_LOCATABLE_SET_ID
+
+  BMC_PROFILE_RULES("simile", (start))
 }
 
 }}
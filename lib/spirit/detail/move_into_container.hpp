@@ -0,0 +1,79 @@
+// Copyright (C) 2026  Mario Lang <mlang@delysid.org>
+//
+// Distributed under the terms of the GNU General Public License version 3.
+// (see accompanying file LICENSE.txt or copy at
+//  http://www.gnu.org/licenses/gpl-3.0-standalone.html)
+
+#ifndef BMC_SPIRIT_DETAIL_MOVE_INTO_CONTAINER_HPP
+#define BMC_SPIRIT_DETAIL_MOVE_INTO_CONTAINER_HPP
+
+#include <utility>
+#include <boost/spirit/home/support/container.hpp>
+#include "bmc/braille/ast/ast.hpp"
+
+/**
+ * \brief Move synthesized syntax tree nodes into their parent container.
+ *
+ * Qi appends the attribute of every element parsed by a list or kleene
+ * parser to the container attribute with traits::push_back, which copies.
+ * Since the element attribute is a temporary owned by the container parser,
+ * moving it is safe, and avoids deep copies of every partial voice, voice
+ * and measure each time it is appended to its parent.
+ */
+#define BMC_MOVE_INTO_CONTAINER(Container)                                    \
+namespace boost { namespace spirit { namespace traits {                       \
+  template <>                                                                 \
+  struct push_back_container<Container, Container::value_type>                \
+  {                                                                           \
+    static bool call(Container &c, Container::value_type const &val)          \
+    {                                                                         \
+      c.push_back(std::move(const_cast<Container::value_type &>(val)));       \
+      return true;                                                            \
+    }                                                                         \
+  };                                                                          \
+}}}
+
+BMC_MOVE_INTO_CONTAINER(::bmc::braille::ast::partial_voice)
+BMC_MOVE_INTO_CONTAINER(::bmc::braille::ast::partial_measure)
+BMC_MOVE_INTO_CONTAINER(::bmc::braille::ast::voice)
+BMC_MOVE_INTO_CONTAINER(std::vector< ::bmc::braille::ast::voice >)
+BMC_MOVE_INTO_CONTAINER(::bmc::braille::ast::paragraph)
+BMC_MOVE_INTO_CONTAINER(std::vector< ::bmc::braille::ast::paragraph >)
+BMC_MOVE_INTO_CONTAINER(::bmc::braille::ast::part)
+BMC_MOVE_INTO_CONTAINER(std::vector< ::bmc::braille::ast::part >)
+
+#undef BMC_MOVE_INTO_CONTAINER
+
+namespace bmc { namespace braille {
+
+/**
+ * \brief Phoenix function object appending a semantic action attribute to a
+ *        container by moving it.
+ */
+struct move_back
+{
+  template <typename>
+  struct result { typedef void type; };
+
+  template <typename Container, typename T>
+  void operator()(Container &c, T &t) const
+  { c.push_back(std::move(t)); }
+};
+
+/**
+ * \brief Phoenix function object moving a semantic action attribute into
+ *        a local variable of its rule.
+ */
+struct move_assign
+{
+  template <typename>
+  struct result { typedef void type; };
+
+  template <typename T>
+  void operator()(T &lhs, T &rhs) const
+  { lhs = std::move(rhs); }
+};
+
+}}
+
+#endif
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 #include <locale.h>
 #include <unordered_map>
 #include <string>
@@ -72,38 +74,6 @@ std::pair<char32_t, char32_t> const name##_aliases[] = {
 #undef BRLTTY_TEXT_TABLE_BEGIN_CHARACTERS
 #undef BRLTTY_TEXT_TABLE_BEGIN_ALIASES
 
-template<size_t N, size_t M>
-uint8_t find(char32_t c,
-	     std::pair<char32_t, uint8_t> const (&mapping)[N],
-	     std::pair<char32_t, char32_t> const (&aliases)[M])
-{
-  if (c >= 0X2800 && c <= 0X28FF) return c & 0XFF;
-  auto i = std::lower_bound(std::begin(mapping), std::end(mapping),
-			    std::make_pair(c, 0),
-			    [](std::pair<char32_t, uint8_t> const &lhs,
-			       std::pair<char32_t, uint8_t> const &rhs)
-			    { return lhs.first < rhs.first; });
-  if (i == std::end(mapping) || i->first != c) {
-    auto j = std::lower_bound(std::begin(aliases), std::end(aliases),
-			      std::make_pair(c, 0),
-			      [](std::pair<char32_t, char32_t> const &lhs,
-				 std::pair<char32_t, char32_t> const &rhs)
-			      { return lhs.first < rhs.first; });
-    if (j != std::end(aliases) && j->first == c) {
-      i = std::lower_bound(std::begin(mapping), std::end(mapping),
-			   std::make_pair(j->second, 0),
-			   [](std::pair<char32_t, uint8_t> const &lhs,
-			      std::pair<char32_t, uint8_t> const &rhs)
-			   { return lhs.first < rhs.first; });
-      if (i != std::end(mapping) && i->first != j->second)
-	i = std::end(mapping);
-    }
-  }
-  if (i != std::end(mapping)) return i->second;
-
-  throw std::runtime_error("no mapping");
-}
-
 std::string const locales[] = {
   "de", "es", "fr_CA", "fr_FR", "en_CA", "en_GB", "en_US"
 };
@@ -139,8 +109,66 @@ void set_default_table_from_locale () {
   }
 }
 
-uint8_t get_dots_for_character(char32_t c, std::string const &locale) {
-#define CHECK(l) if (locale == #l) return ::find(c, l##_mappings, l##_aliases);
+constexpr std::uint16_t braille_table::unmapped;
+
+braille_table::braille_table
+( std::pair<char32_t, std::uint8_t> const *mapping_begin
+, std::pair<char32_t, std::uint8_t> const *mapping_end
+, std::pair<char32_t, char32_t> const *aliases_begin
+, std::pair<char32_t, char32_t> const *aliases_end
+)
+: bmp(0X10000, unmapped)
+{
+  auto add = [this](char32_t c, std::uint8_t dots) {
+    if (c < bmp.size()) {
+      if (bmp[c] == unmapped) bmp[c] = dots;
+    } else {
+      others.emplace(c, dots);
+    }
+  };
+  // Unicode braille takes precedence over whatever the table says.
+  for (char32_t c = 0X2800; c <= 0X28FF; ++c) add(c, c & 0XFF);
+  for (auto i = mapping_begin; i != mapping_end; ++i) add(i->first, i->second);
+  for (auto i = aliases_begin; i != aliases_end; ++i) {
+    auto const target = std::lower_bound(mapping_begin, mapping_end,
+					 std::make_pair(i->second, 0),
+					 [](std::pair<char32_t, uint8_t> const &lhs,
+					    std::pair<char32_t, uint8_t> const &rhs)
+					 { return lhs.first < rhs.first; });
+    if (target != mapping_end && target->first == i->second)
+      add(i->first, target->second);
+  }
+}
+
+namespace {
+
+thread_local braille_table const *scoped_table = nullptr;
+
+}
+
+braille_table::scope::scope(braille_table const &table)
+: previous(scoped_table)
+{ scoped_table = &table; }
+
+braille_table::scope::~scope() { scoped_table = previous; }
+
+braille_table const *braille_table::scoped() { return scoped_table; }
+
+void braille_table::no_mapping()
+{
+  throw std::runtime_error("no mapping");
+}
+
+braille_table const &get_braille_table(std::string const &name) {
+#define CHECK(l)                                                              \
+  if (name == #l) {                                                           \
+    static braille_table const table( std::begin(l##_mappings)                \
+                                    , std::end(l##_mappings)                  \
+                                    , std::begin(l##_aliases)                 \
+                                    , std::end(l##_aliases)                   \
+                                    );                                        \
+    return table;                                                             \
+  }
   CHECK(brf);
   CHECK(de);
   CHECK(es);
@@ -153,5 +181,14 @@ uint8_t get_dots_for_character(char32_t c, std::string const &locale) {
 #undef CHECK
 }
 
+braille_table const &current_braille_table() {
+  if (braille_table const *table = braille_table::scoped()) return *table;
+  return get_braille_table(default_table);
+}
+
+uint8_t get_dots_for_character(char32_t c, std::string const &table) {
+  return get_braille_table(table).dots(c);
+}
+
 }}
 
@@ -11,6 +11,7 @@
 #include <boost/spirit/include/phoenix_object.hpp>
 #include "brlsym.hpp"
 #include <bmc/braille/parsing/qi/primitive/brl.hpp>
+#include <bmc/braille/parsing/profile.hpp>
 
 namespace bmc { namespace braille {
 
@@ -31,6 +32,8 @@ time_signature_grammar<Iterator>::time_signature_grammar()
         | brl(456)
        >> brl(14)[_val = construct<::bmc::time_signature>(4, 4)]
         ;
+
+  BMC_PROFILE_RULES("time_signature", (start))
 }
 
 }}
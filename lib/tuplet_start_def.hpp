@@ -13,6 +13,7 @@
 #include "brlsym.hpp"
 #include <bmc/braille/parsing/error_handler.hpp>
 #include <bmc/braille/parsing/annotation.hpp>
+#include <bmc/braille/parsing/profile.hpp>
 #include <boost/spirit/include/qi_core.hpp>
 #include <boost/spirit/include/phoenix_core.hpp>
 #include <boost/spirit/include/phoenix_function.hpp>
@@ -47,10 +48,12 @@ tuplet_start_grammar<Iterator>::tuplet_start_grammar(error_handler<Iterator>& er
 
 #define BMC_LOCATABLE_SET_ID(rule) \
   boost::spirit::qi::on_success(rule,\
-                                annotation_function(error_handler.ranges)\
+                                annotation_function(error_handler)\
                                 (_val, _1, _3))
   BMC_LOCATABLE_SET_ID(start);
 #undef BMC_LOCATABLE_SET_ID
+
+  BMC_PROFILE_RULES("tuplet_start", (start))
 }
 
 }}
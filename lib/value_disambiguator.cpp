@@ -25,6 +25,7 @@ value_disambiguator::operator()(ast::measure& measure)
   if (!interpretations.contains_complete_measure() && !interpretations.empty()) {
     if (!anacrusis) {
       anacrusis = interpretations;
+      anacrusis_measure = &measure;
       prev_duration = 0;
       prev_doubled_tuplets.clear();
       return true;
@@ -35,9 +36,11 @@ value_disambiguator::operator()(ast::measure& measure)
         for (auto& rhs: interpretations) {
           if (duration(lhs) + duration(rhs) == time_signature) {
             lhs.accept(), rhs.accept();
+            cache_durations(*anacrusis_measure), cache_durations(measure);
             prev_duration = duration(rhs);
             prev_doubled_tuplets = rhs.get_doubled_tuplets();
             anacrusis.reset();
+            anacrusis_measure = nullptr;
             return true;
           }
         }
@@ -48,6 +51,7 @@ value_disambiguator::operator()(ast::measure& measure)
   if (interpretations.size() == 1) {
     auto &proxied_measure = interpretations.front();
     proxied_measure.accept();
+    cache_durations(measure);
     prev_duration = duration(proxied_measure);
     prev_doubled_tuplets = proxied_measure.get_doubled_tuplets();
     return true;
@@ -77,7 +81,10 @@ value_disambiguator::end_of_staff() const {
     report_error(anacrusis->get_measure_id(), msg.str());
     return false;
   }
-  if (anacrusis && !anacrusis->empty()) anacrusis->front().accept();
+  if (anacrusis && !anacrusis->empty()) {
+    anacrusis->front().accept();
+    cache_durations(*anacrusis_measure);
+  }
   return true;
 }
 
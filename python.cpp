@@ -9,27 +9,39 @@
 #include "bmc/braille/parsing/grammar/score.hpp"
 #include "bmc/braille/reformat.hpp"
 #include "bmc/braille/semantic_analysis.hpp"
+#include "bmc/braille/text2braille.hpp"
 #include "bmc/lilypond.hpp"
+#include "bmc/midi.hpp"
 #include "bmc/musicxml.hpp"
 
 #define BOOST_PYTHON_PY_SIGNATURES_PROPER_INIT_SELF_TYPE
 #include <boost/python.hpp>
 
-static std::string to_lilypond(std::wstring const &source) {
+// Built on first use, instead of on every conversion.
+static ::bmc::braille::score_parser<std::wstring::const_iterator> const &
+parser() {
+  static ::bmc::braille::score_parser<std::wstring::const_iterator> const
+  instance;
+  return instance;
+}
+
+static std::string to_lilypond(std::wstring source) {
+  auto const &table =
+    ::bmc::braille::get_braille_table(::bmc::braille::default_table);
+  table.to_unicode_braille(source);
   typedef std::wstring::const_iterator iterator_type;
 
   iterator_type iter = source.begin();
   iterator_type const end = source.end();
   typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
   error_handler_type error_handler(iter, end);
-  typedef ::bmc::braille::score_grammar<iterator_type> parser_type;
-  parser_type parser(error_handler);
-  boost::spirit::traits::attribute_of<parser_type>::type score;
+  ::bmc::braille::ast::score score;
 
-  bool const success = parse(iter, end, parser, score);
+  bool const success = parser()(iter, end, error_handler, score, table);
 
   if (success && iter == end) {
     ::bmc::braille::compiler<error_handler_type> compile(error_handler);
+    compile.discard_source_tree();
     if (compile(score)) {
       std::wcerr << error_handler;
       std::stringstream ss;
@@ -41,21 +53,23 @@ static std::string to_lilypond(std::wstring const &source) {
   return "";
 }
 
-static std::string to_musicxml(std::wstring const &source) {
+static std::string to_musicxml(std::wstring source) {
+  auto const &table =
+    ::bmc::braille::get_braille_table(::bmc::braille::default_table);
+  table.to_unicode_braille(source);
   typedef std::wstring::const_iterator iterator_type;
 
   iterator_type iter = source.begin();
   iterator_type const end = source.end();
   typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
   error_handler_type error_handler(iter, end);
-  typedef ::bmc::braille::score_grammar<iterator_type> parser_type;
-  parser_type parser(error_handler);
-  boost::spirit::traits::attribute_of<parser_type>::type score;
+  ::bmc::braille::ast::score score;
 
-  bool const success = parse(iter, end, parser, score);
+  bool const success = parser()(iter, end, error_handler, score, table);
 
   if (success && iter == end) {
     ::bmc::braille::compiler<error_handler_type> compile(error_handler);
+    compile.discard_source_tree();
     if (compile(score)) {
       std::wcerr << error_handler;
       std::stringstream ss;
@@ -66,18 +80,50 @@ static std::string to_musicxml(std::wstring const &source) {
   return "";
 }
 
-static std::string reformat(std::wstring const &source) {
+// Standard MIDI Files are binary, return them as bytes instead of str.
+static boost::python::object to_midi(std::wstring source) {
+  auto const &table =
+    ::bmc::braille::get_braille_table(::bmc::braille::default_table);
+  table.to_unicode_braille(source);
+  typedef std::wstring::const_iterator iterator_type;
+
+  iterator_type iter = source.begin();
+  iterator_type const end = source.end();
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  error_handler_type error_handler(iter, end);
+  ::bmc::braille::ast::score score;
+
+  bool const success = parser()(iter, end, error_handler, score, table);
+
+  std::string midi;
+  if (success && iter == end) {
+    ::bmc::braille::compiler<error_handler_type> compile(error_handler);
+    compile.discard_source_tree();
+    if (compile(score)) {
+      std::wcerr << error_handler;
+      std::stringstream ss;
+      ::bmc::midi::standard_midi_file(ss, score);
+      midi = ss.str();
+    }
+  }
+  return boost::python::object(boost::python::handle<>(
+    PyBytes_FromStringAndSize(midi.data(), midi.size())
+  ));
+}
+
+static std::string reformat(std::wstring source) {
+  auto const &table =
+    ::bmc::braille::get_braille_table(::bmc::braille::default_table);
+  table.to_unicode_braille(source);
   typedef std::wstring::const_iterator iterator_type;
 
   iterator_type iter = source.begin();
   iterator_type const end = source.end();
   typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
   error_handler_type error_handler(iter, end);
-  typedef ::bmc::braille::score_grammar<iterator_type> parser_type;
-  parser_type parser(error_handler);
-  boost::spirit::traits::attribute_of<parser_type>::type score;
+  ::bmc::braille::ast::score score;
 
-  bool const success = parse(iter, end, parser, score);
+  bool const success = parser()(iter, end, error_handler, score, table);
 
   if (success && iter == end) {
     ::bmc::braille::compiler<error_handler_type> compile(error_handler);
@@ -162,5 +208,6 @@ BOOST_PYTHON_MODULE(_bmc) {
     ;
   def("to_lilypond", &to_lilypond);
   def("to_musicxml", &to_musicxml);
+  def("to_midi", &to_midi);
   def("reformat", &reformat);
 }
@@ -22,6 +22,36 @@ struct text_table
 
 BOOST_GLOBAL_FIXTURE(text_table);
 
+#include <chrono>
+
+BOOST_AUTO_TEST_CASE(braille_table_lookup) {
+  using bmc::braille::get_braille_table;
+  auto const &brf = get_braille_table("brf");
+  auto const &de = get_braille_table("de");
+  BOOST_CHECK(&brf == &get_braille_table("brf"));
+  BOOST_CHECK_EQUAL(brf.dots(U'a'), 0X01);
+  BOOST_CHECK_EQUAL(brf.dots(U'A'), 0X01);
+  BOOST_CHECK_EQUAL(de.dots(U'A'), 0X41);
+  BOOST_CHECK_EQUAL(de.dots(0XA0), de.dots(U' ')); // alias
+  BOOST_CHECK_EQUAL(de.dots(0X283F), 0X3F);
+  BOOST_CHECK_EQUAL(bmc::braille::get_dots_for_character(U'a'), 0X01);
+  BOOST_CHECK_THROW(de.dots(0X1F3B5), std::runtime_error);
+  BOOST_CHECK_THROW(get_braille_table("xx"), std::runtime_error);
+
+  std::u32string const text(U"!d3ac/ !4%l7^=~b2k");
+  std::size_t const rounds = 100000;
+  unsigned sum = 0;
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < rounds; ++i)
+    for (char32_t c: text) sum += de.dots(c);
+  std::chrono::duration<double> const elapsed =
+    std::chrono::steady_clock::now() - start;
+  BOOST_CHECK(sum > 0);
+  BOOST_TEST_MESSAGE("braille_table: "
+                     << rounds * text.size() / elapsed.count()
+                     << " lookups per second");
+}
+
 #include <boost/spirit/include/qi_parse.hpp>
 #include <boost/spirit/include/qi_core.hpp>
 #include <bmc/braille/parsing/grammar/time_signature.hpp>
@@ -265,8 +295,8 @@ BOOST_AUTO_TEST_CASE(compiler_test1) {
   BOOST_CHECK(attribute.voices[0].size() == 1);
   BOOST_CHECK(attribute.voices[0][0].size() == 1);
   BOOST_CHECK(attribute.voices[0][0][0].size() == 9);
-  BOOST_CHECK_EQUAL(errors.ranges.size(), std::size_t(31));
-  BOOST_CHECK(errors.ranges[0].begin() == input.begin());
+  BOOST_CHECK_EQUAL(errors.ranges.size(), std::size_t(13));
+  BOOST_CHECK(errors.range(0).begin() == input.begin());
   ::bmc::braille::compiler<error_handler_type> compile(errors);
   BOOST_CHECK(compile(attribute));
   BOOST_CHECK_EQUAL(boost::apply_visitor(get_type(), attribute.voices[0][0][0][0]), ::bmc::rational(1, 16));
@@ -321,6 +351,27 @@ BOOST_AUTO_TEST_CASE(score_solo_test2) {
   BOOST_CHECK(compile(attribute));
 }
 
+BOOST_AUTO_TEST_CASE(score_solo_test2_unicode_braille) {
+  std::wstring input(L"#c/\n⠐⠞⠃⠝⠞⠎⠚⠂⠈⠉⠞⠟⠗⠁⠎⠾⠽⠐⠢⠕⠽⠚⠊⠓2k");
+  ::bmc::braille::get_braille_table(::bmc::braille::default_table)
+  .to_unicode_braille(input);
+  BOOST_CHECK(input.substr(0, 4) == L"⠼⠉⠲\n");
+  BOOST_CHECK(input.substr(input.length() - 2) == L"⠣⠅");
+  typedef std::wstring::const_iterator iterator_type;
+  iterator_type begin(input.begin());
+  iterator_type const end(input.end());
+  typedef ::bmc::braille::score_grammar<iterator_type> parser_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  error_handler_type errors(begin, end);
+  parser_type parser(errors);
+  boost::spirit::traits::attribute_of<parser_type>::type attribute;
+  BOOST_REQUIRE(parse(begin, end, parser, attribute));
+  BOOST_CHECK(begin == end);
+  BOOST_REQUIRE_EQUAL(attribute.parts.size(), std::size_t(1));
+  ::bmc::braille::compiler<error_handler_type> compile(errors);
+  BOOST_CHECK(compile(attribute));
+}
+
 BOOST_AUTO_TEST_CASE(score_tuplet_test1) {
   std::locale::global(std::locale(""));
   std::wstring const input(L"⠐⠹⠱⠆⠋⠛⠓⠆⠊⠚⠙⠣⠅");
@@ -1015,6 +1066,692 @@ BOOST_AUTO_TEST_CASE(bwv988_v10) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(bwv988_v10_unfold_destructively) {
+  std::ifstream file{"input/bwv988-v10.bmc"};
+  BOOST_REQUIRE(file.good());
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  auto const input = utf_to_utf<wchar_t>(std::string(file_begin, file_end));
+  BOOST_REQUIRE(!input.empty());
+  typedef std::wstring::const_iterator iterator_type;
+  iterator_type begin(input.begin());
+  iterator_type const end(input.end());
+  typedef ::bmc::braille::score_grammar<iterator_type> parser_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  error_handler_type errors(begin, end);
+  parser_type parser(errors);
+  boost::spirit::traits::attribute_of<parser_type>::type attribute;
+  BOOST_REQUIRE(parse(begin, end, parser, attribute));
+  BOOST_CHECK(begin == end);
+  ::bmc::braille::compiler<error_handler_type> compile(errors);
+  BOOST_REQUIRE(compile(attribute));
+
+  // Moving the signs out of the raw AST must not change the unfolded result.
+  attribute.unfolded_part.clear();
+  BOOST_REQUIRE(compile.unfold_destructively(attribute));
+  BOOST_CHECK_EQUAL(attribute.parts.size(), attribute.unfolded_part.size());
+
+  {
+    output_test_stream ts{"output/bwv988-v10.ly"};
+    ::bmc::lilypond_output_format(ts);
+    ts << attribute;
+    BOOST_CHECK(ts.match_pattern());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(bwv988_v10_discard_source_tree) {
+  std::ifstream file{"input/bwv988-v10.bmc"};
+  BOOST_REQUIRE(file.good());
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  auto const input = utf_to_utf<wchar_t>(std::string(file_begin, file_end));
+  BOOST_REQUIRE(!input.empty());
+  typedef std::wstring::const_iterator iterator_type;
+  iterator_type begin(input.begin());
+  iterator_type const end(input.end());
+  typedef ::bmc::braille::score_grammar<iterator_type> parser_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  error_handler_type errors(begin, end);
+  parser_type parser(errors);
+  boost::spirit::traits::attribute_of<parser_type>::type attribute;
+  BOOST_REQUIRE(parse(begin, end, parser, attribute));
+  BOOST_CHECK(begin == end);
+  ::bmc::braille::compiler<error_handler_type> compile(errors);
+  compile.discard_source_tree();
+  BOOST_REQUIRE(compile(attribute));
+  BOOST_CHECK(attribute.parts.empty());
+  BOOST_CHECK(errors.ranges.empty());
+  BOOST_CHECK_EQUAL(attribute.unfolded_part.size(), std::size_t(1));
+
+  {
+    output_test_stream ts{"output/bwv988-v10.ly"};
+    ::bmc::lilypond_output_format(ts);
+    ts << attribute;
+    BOOST_CHECK(ts.match_pattern());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(bwv988_v10_cached_durations) {
+  std::ifstream file{"input/bwv988-v10.bmc"};
+  BOOST_REQUIRE(file.good());
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  auto const input = utf_to_utf<wchar_t>(std::string(file_begin, file_end));
+  BOOST_REQUIRE(!input.empty());
+  typedef std::wstring::const_iterator iterator_type;
+  iterator_type begin(input.begin());
+  iterator_type const end(input.end());
+  typedef ::bmc::braille::score_grammar<iterator_type> parser_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  error_handler_type errors(begin, end);
+  parser_type parser(errors);
+  boost::spirit::traits::attribute_of<parser_type>::type attribute;
+  BOOST_REQUIRE(parse(begin, end, parser, attribute));
+  BOOST_CHECK(begin == end);
+  ::bmc::braille::compiler<error_handler_type> compile(errors);
+  BOOST_REQUIRE(compile(attribute));
+
+  std::size_t measures = 0;
+  for (auto const &section: attribute.parts.front()) {
+    for (auto const &paragraph: section.paragraphs) {
+      for (auto const &element: paragraph) {
+        if (auto measure = boost::get<::bmc::braille::ast::measure>(&element)) {
+          BOOST_REQUIRE(measure->cached_duration());
+          for (auto const &voice: measure->voices) {
+            BOOST_CHECK(voice.cached_duration());
+            for (auto const &partial_measure: voice)
+              for (auto const &partial_voice: partial_measure)
+                BOOST_CHECK_EQUAL(*partial_voice.cached_duration(),
+                                  boost::accumulate(partial_voice, ::bmc::rational()));
+          }
+          ++measures;
+        }
+      }
+    }
+  }
+  BOOST_CHECK(measures > 0);
+
+  for (auto const &staff: attribute.unfolded_part.front()) {
+    for (auto const &element: staff) {
+      if (auto measure = boost::get<::bmc::braille::ast::unfolded::measure>(&element)) {
+        BOOST_REQUIRE(measure->cached_duration());
+        for (auto const &voice: measure->voices)
+          for (auto const &partial_measure: voice)
+            for (auto const &partial_voice: partial_measure)
+              BOOST_CHECK_EQUAL(*partial_voice.cached_duration(),
+                                boost::accumulate(partial_voice, ::bmc::rational()));
+      }
+    }
+  }
+}
+
+#include "bmc/braille/parsing/iterator.hpp"
+
+// Returns the character positions of all annotated syntax tree nodes.
+template <typename Iterator>
+std::vector<std::ptrdiff_t> check_bwv988_v10(Iterator begin, Iterator const end) {
+  typedef ::bmc::braille::score_grammar<Iterator> parser_type;
+  typedef ::bmc::braille::error_handler<Iterator> error_handler_type;
+  error_handler_type errors(begin, end);
+  parser_type parser(errors);
+  typename boost::spirit::traits::attribute_of<parser_type>::type attribute;
+  BOOST_REQUIRE(parse(begin, end, parser, attribute));
+  BOOST_CHECK(begin == end);
+  std::vector<std::ptrdiff_t> positions;
+  for (std::size_t id = 0; id < errors.ranges.size(); ++id) {
+    auto const range = errors.range(id);
+    positions.push_back(std::distance(errors.first, range.begin()));
+    positions.push_back(std::distance(errors.first, range.end()));
+  }
+  ::bmc::braille::compiler<error_handler_type> compile(errors);
+  BOOST_REQUIRE(compile(attribute));
+
+  output_test_stream ts{"output/bwv988-v10.ly"};
+  ::bmc::lilypond_output_format(ts);
+  ts << attribute;
+  BOOST_CHECK(ts.match_pattern());
+  return positions;
+}
+
+BOOST_AUTO_TEST_CASE(bwv988_v10_utf8_and_utf32) {
+  std::ifstream file{"input/bwv988-v10.bmc"};
+  BOOST_REQUIRE(file.good());
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  std::string const utf8(file_begin, file_end);
+  BOOST_REQUIRE(!utf8.empty());
+  auto const utf8_positions =
+    check_bwv988_v10( ::bmc::braille::utf8_iterator(utf8.data())
+                    , ::bmc::braille::utf8_iterator(utf8.data() + utf8.size())
+                    );
+  auto const utf32 = utf_to_utf<char32_t>(utf8);
+  auto const utf32_positions =
+    check_bwv988_v10<::bmc::braille::utf32_iterator>
+    (utf32.data(), utf32.data() + utf32.size());
+  BOOST_CHECK(!utf8_positions.empty());
+  BOOST_CHECK(utf8_positions == utf32_positions);
+}
+
+// Characters per second score_parser gets through.
+template <typename Iterator>
+double score_parser_throughput(Iterator const begin, Iterator const end) {
+  typedef ::bmc::braille::error_handler<Iterator> error_handler_type;
+  ::bmc::braille::score_parser<Iterator> const parser;
+  std::size_t const rounds = 20;
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < rounds; ++i) {
+    Iterator iter(begin);
+    error_handler_type errors(begin, end);
+    ::bmc::braille::ast::score score;
+    BOOST_REQUIRE(parser(iter, end, errors, score));
+    BOOST_CHECK(iter == end);
+  }
+  std::chrono::duration<double> const elapsed =
+    std::chrono::steady_clock::now() - start;
+  return rounds * std::distance(begin, end) / elapsed.count();
+}
+
+BOOST_AUTO_TEST_CASE(score_parser_benchmark) {
+  std::ifstream file{"input/bwv988-v10.bmc"};
+  BOOST_REQUIRE(file.good());
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  std::string const utf8(file_begin, file_end);
+  BOOST_REQUIRE(!utf8.empty());
+  auto const wide = utf_to_utf<wchar_t>(utf8);
+  auto const utf32 = utf_to_utf<char32_t>(utf8);
+
+  BOOST_TEST_MESSAGE("score_parser: "
+                     << score_parser_throughput(wide.cbegin(), wide.cend())
+                     << " characters per second from std::wstring");
+  BOOST_TEST_MESSAGE("score_parser: "
+                     << score_parser_throughput
+                        ( ::bmc::braille::utf8_iterator(utf8.data())
+                        , ::bmc::braille::utf8_iterator(utf8.data() + utf8.size())
+                        )
+                     << " characters per second from UTF-8");
+  BOOST_TEST_MESSAGE("score_parser: "
+                     << score_parser_throughput<::bmc::braille::utf32_iterator>
+                        (utf32.data(), utf32.data() + utf32.size())
+                     << " characters per second from UTF-32");
+}
+
+template <typename ErrorHandler>
+struct locatable_ranges
+: ::bmc::braille::ast::const_visitor<locatable_ranges<ErrorHandler>>
+{
+  ErrorHandler const &errors;
+  std::vector<typename ErrorHandler::iterator_type> ranges;
+
+  locatable_ranges(ErrorHandler const &errors) : errors(errors) {}
+
+  bool walk_up_from_locatable(::bmc::braille::ast::locatable const &node) {
+    if (node.id >= 0) {
+      BOOST_REQUIRE(std::size_t(node.id) < errors.ranges.size());
+      ranges.push_back(errors.range(node.id).begin());
+      ranges.push_back(errors.range(node.id).end());
+    }
+    return true;
+  }
+};
+
+BOOST_AUTO_TEST_CASE(parse_score_in_parallel) {
+  std::ifstream file{"input/bwv988-v10.bmc"};
+  BOOST_REQUIRE(file.good());
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  std::string const utf8(file_begin, file_end);
+  BOOST_REQUIRE(!utf8.empty());
+  // Repeat everything but the key and time signature, one part each time.
+  std::string input(utf8);
+  for (int i = 1; i < 80; ++i) input += utf8.substr(utf8.find('\n') + 1);
+
+  typedef ::bmc::braille::utf8_iterator iterator_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  iterator_type const begin(input.data()), end(input.data() + input.size());
+
+  error_handler_type errors(begin, end);
+  ::bmc::braille::score_grammar<iterator_type> parser(errors);
+  ::bmc::braille::ast::score expected;
+  iterator_type iter(begin);
+  BOOST_REQUIRE(parse(iter, end, parser, expected));
+  BOOST_CHECK(iter == end);
+  BOOST_CHECK_EQUAL(expected.parts.size(), std::size_t(80));
+  locatable_ranges<error_handler_type> expected_ranges(errors);
+  BOOST_REQUIRE(expected_ranges.traverse_score(expected));
+  BOOST_CHECK(!expected_ranges.ranges.empty());
+
+  for (unsigned jobs: {1, 4}) {
+    error_handler_type errors(begin, end);
+    ::bmc::braille::ast::score score;
+    iterator_type iter(begin);
+    BOOST_REQUIRE(::bmc::braille::parse_score(
+      iter, end, errors, score,
+      ::bmc::braille::current_braille_table(), jobs
+    ));
+    BOOST_CHECK(iter == end);
+    BOOST_CHECK_EQUAL(score.key_sig, expected.key_sig);
+    BOOST_CHECK_EQUAL(score.parts.size(), expected.parts.size());
+    locatable_ranges<error_handler_type> ranges(errors);
+    BOOST_REQUIRE(ranges.traverse_score(score));
+    BOOST_CHECK(ranges.ranges == expected_ranges.ranges);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parse_score_pipelined) {
+  std::ifstream file{"input/bwv988-v10.bmc"};
+  BOOST_REQUIRE(file.good());
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  std::string const utf8(file_begin, file_end);
+  BOOST_REQUIRE(!utf8.empty());
+  std::string input(utf8);
+  for (int i = 1; i < 80; ++i) input += utf8.substr(utf8.find('\n') + 1);
+
+  typedef ::bmc::braille::utf8_iterator iterator_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  iterator_type const begin(input.data()), end(input.data() + input.size());
+
+  auto const to_lilypond = [&](bool pipelined) {
+    error_handler_type errors(begin, end);
+    ::bmc::braille::compiler<error_handler_type> compile(errors);
+    auto const hooks = compile.pipeline();
+    ::bmc::braille::section_pipeline pipeline;
+    std::size_t sections = 0;
+    if (pipelined) {
+      pipeline.section = [&](::bmc::braille::ast::score const &score,
+                             ::bmc::braille::section_kind kind,
+                             ::bmc::braille::ast::section &section) {
+        ++sections;
+        hooks.section(score, kind, section);
+      };
+      pipeline.finish = hooks.finish;
+    }
+    ::bmc::braille::ast::score score;
+    iterator_type iter(begin);
+    BOOST_REQUIRE(::bmc::braille::parse_score(
+      iter, end, errors, score,
+      ::bmc::braille::current_braille_table(), 4, pipeline
+    ));
+    BOOST_CHECK(iter == end);
+    BOOST_CHECK_EQUAL(sections != 0, pipelined);
+    BOOST_REQUIRE(compile(score));
+    std::stringstream ly;
+    ::bmc::lilypond::generator generate(ly, true, true, true);
+    generate(score);
+    return ly.str();
+  };
+
+  std::string const expected = to_lilypond(false);
+  BOOST_CHECK(!expected.empty());
+  BOOST_CHECK(to_lilypond(true) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(score_parser_reuse) {
+  typedef std::wstring::const_iterator iterator_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  ::bmc::braille::score_parser<iterator_type> const parser;
+
+  auto const to_lilypond = [&parser](std::string const &name) {
+    std::ifstream file{"input/" + name + ".bmc"};
+    std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+    auto const input = utf_to_utf<wchar_t>(std::string(file_begin, file_end));
+    iterator_type begin(input.begin());
+    iterator_type const end(input.end());
+    error_handler_type errors(begin, end);
+    ::bmc::braille::ast::score score;
+    std::stringstream ly;
+    if (parser(begin, end, errors, score) && begin == end) {
+      ::bmc::braille::compiler<error_handler_type> compile(errors);
+      if (compile(score)) {
+        ::bmc::lilypond_output_format(ly);
+        ly << score;
+      }
+    }
+    return ly.str();
+  };
+
+  std::vector<std::string> const names { "bwv988-v01", "bwv988-v10" };
+  std::vector<std::future<std::string>> results;
+  for (int i = 0; i < 4; ++i)
+    for (auto const &name: names)
+      results.push_back(std::async(std::launch::async, to_lilypond, name));
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    output_test_stream ts{"output/" + names[i % names.size()] + ".ly"};
+    ts << results[i].get();
+    BOOST_CHECK(ts.match_pattern());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(score_parser_error_recovery) {
+  typedef std::wstring::const_iterator iterator_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  std::ifstream file{"input/bwv988-v10.bmc"};
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  auto input = utf_to_utf<wchar_t>(std::string(file_begin, file_end));
+  BOOST_REQUIRE(!input.empty());
+
+  // A stray sign in a measure of the right hand, and another one starting a
+  // continuation line of the left hand.
+  std::size_t const measure = input.find(L"⠐⠫⠹⠪⠹⠂");
+  BOOST_REQUIRE(measure != std::wstring::npos);
+  input.insert(measure + 3, L"⠜");
+  std::size_t line = 0;
+  for (int i = 0; i < 4; ++i) line = input.find(L'\n', line) + 1;
+  input.insert(line, L"⠜");
+
+  ::bmc::braille::score_parser<iterator_type> const parser;
+  iterator_type begin(input.begin());
+  iterator_type const end(input.end());
+  error_handler_type errors(begin, end);
+  ::bmc::braille::ast::score score;
+  BOOST_REQUIRE(parser(begin, end, errors, score));
+  BOOST_CHECK(begin == end);
+
+  std::size_t unparsable = 0;
+  for (auto const &part: score.parts)
+    for (auto const &section: part)
+      for (auto const &paragraph: section.paragraphs)
+        for (auto const &element: paragraph)
+          if (boost::get<::bmc::braille::ast::unparsable>(&element))
+            ++unparsable;
+  BOOST_CHECK_EQUAL(unparsable, std::size_t(2));
+
+  // Both errors are reported, each with the offending line and a caret.
+  BOOST_REQUIRE_EQUAL(errors.messages->size(), std::size_t(6));
+  BOOST_CHECK((*errors.messages)[0] == L"<INPUT>:2:46: error: unexpected sign");
+  BOOST_CHECK((*errors.messages)[3] == L"<INPUT>:5:1: error: unexpected sign");
+
+  ::bmc::braille::compiler<error_handler_type> compile(errors);
+  BOOST_CHECK(!compile(score));
+}
+
+// Generates LilyPond source code for the Goldberg variations which compile,
+// and reports how many megabytes per second lilypond::generator produces.
+BOOST_AUTO_TEST_CASE(lilypond_generator_benchmark) {
+  typedef std::wstring::const_iterator iterator_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  ::bmc::braille::score_parser<iterator_type> const parser;
+  std::vector<std::string> const names {
+    "bwv988-v01", "bwv988-v02", "bwv988-v04", "bwv988-v05", "bwv988-v14",
+    "bwv988-v15", "bwv988-v18", "bwv988-v19", "bwv988-v22"
+  };
+  std::vector<::bmc::braille::ast::score> scores;
+  for (auto const &name: names) {
+    std::ifstream file{"input/" + name + ".bmc"};
+    BOOST_REQUIRE(file.good());
+    std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+    auto const input = utf_to_utf<wchar_t>(std::string(file_begin, file_end));
+    iterator_type begin(input.begin());
+    iterator_type const end(input.end());
+    error_handler_type errors(begin, end);
+    scores.emplace_back();
+    BOOST_REQUIRE(parser(begin, end, errors, scores.back()));
+    ::bmc::braille::compiler<error_handler_type> compile(errors);
+    BOOST_REQUIRE(compile(scores.back()));
+  }
+
+  std::size_t const rounds = 20;
+  std::size_t bytes = 0;
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < rounds; ++i) {
+    for (auto const &score: scores) {
+      std::stringstream ly;
+      ::bmc::lilypond::generator generate(ly, true, true, true);
+      generate(score);
+      bytes += ly.str().size();
+    }
+  }
+  std::chrono::duration<double> const elapsed =
+    std::chrono::steady_clock::now() - start;
+  BOOST_CHECK(bytes > 0);
+  BOOST_TEST_MESSAGE("lilypond::generator: "
+                     << bytes / elapsed.count() / (1024 * 1024)
+                     << " MB per second");
+}
+
+BOOST_AUTO_TEST_CASE(musicxml_writers_agree) {
+  typedef std::wstring::const_iterator iterator_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  ::bmc::braille::score_parser<iterator_type> const parser;
+  for (std::string const name: { "bwv988-v01", "bwv988-v02", "bwv988-v04",
+                                 "bwv988-v05", "bwv988-v19", "bwv988-v22" }) {
+    std::ifstream file{"input/" + name + ".bmc"};
+    BOOST_REQUIRE(file.good());
+    std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+    auto const input = utf_to_utf<wchar_t>(std::string(file_begin, file_end));
+    iterator_type begin(input.begin());
+    iterator_type const end(input.end());
+    error_handler_type errors(begin, end);
+    ::bmc::braille::ast::score score;
+    BOOST_REQUIRE(parser(begin, end, errors, score));
+    ::bmc::braille::compiler<error_handler_type> compile(errors);
+    BOOST_REQUIRE(compile(score));
+
+    std::stringstream streamed, serialized;
+    ::bmc::musicxml(streamed, score);
+    ::bmc::musicxml_via_xsd(serialized, score);
+    BOOST_CHECK(!streamed.str().empty());
+    BOOST_CHECK_MESSAGE(streamed.str() == serialized.str(), name);
+  }
+}
+
+#include <zlib.h>
+
+BOOST_AUTO_TEST_CASE(compressed_musicxml) {
+  typedef std::wstring::const_iterator iterator_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  std::ifstream file{"input/bwv988-v01.bmc"};
+  BOOST_REQUIRE(file.good());
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  auto const input = utf_to_utf<wchar_t>(std::string(file_begin, file_end));
+  iterator_type begin(input.begin());
+  iterator_type const end(input.end());
+  error_handler_type errors(begin, end);
+  ::bmc::braille::ast::score score;
+  BOOST_REQUIRE(::bmc::braille::score_parser<iterator_type>()(begin, end, errors, score));
+  ::bmc::braille::compiler<error_handler_type> compile(errors);
+  BOOST_REQUIRE(compile(score));
+
+  std::stringstream xml, mxl;
+  ::bmc::musicxml(xml, score);
+  ::bmc::compressed_musicxml(mxl, score);
+  std::string const archive = mxl.str();
+  BOOST_CHECK_LT(archive.size(), xml.str().size() / 10);
+
+  // Walk the local file headers, inflating deflated entries.
+  auto const u16 = [&archive](std::size_t at) {
+    return unsigned(static_cast<unsigned char>(archive[at])) |
+           unsigned(static_cast<unsigned char>(archive[at + 1])) << 8;
+  };
+  std::vector<std::string> names;
+  std::string score_xml;
+  std::size_t at = 0;
+  while (archive.compare(at, 4, "PK\3\4") == 0) {
+    unsigned const method = u16(at + 8);
+    std::string const name = archive.substr(at + 30, u16(at + 26));
+    names.push_back(name);
+    at += 30 + name.size() + u16(at + 28);
+    if (method == 0) {
+      std::size_t const size = u16(at - name.size() - 30 + 22) |
+                               u16(at - name.size() - 30 + 24) << 16;
+      if (name == "mimetype")
+        BOOST_CHECK_EQUAL(archive.substr(at, size),
+                          "application/vnd.recordare.musicxml");
+      at += size;
+    } else {
+      BOOST_REQUIRE_EQUAL(method, 8U);
+      z_stream z {};
+      BOOST_REQUIRE_EQUAL(inflateInit2(&z, -MAX_WBITS), Z_OK);
+      z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(archive.data() + at));
+      z.avail_in = archive.size() - at;
+      char buffer[0X1000];
+      int status;
+      do {
+        z.next_out = reinterpret_cast<Bytef *>(buffer);
+        z.avail_out = sizeof(buffer);
+        status = inflate(&z, Z_NO_FLUSH);
+        BOOST_REQUIRE(status == Z_OK || status == Z_STREAM_END);
+        score_xml.append(buffer, sizeof(buffer) - z.avail_out);
+      } while (status != Z_STREAM_END);
+      at += z.total_in + 16; // Data descriptor
+      inflateEnd(&z);
+    }
+  }
+  BOOST_CHECK(archive.compare(at, 4, "PK\1\2") == 0);
+  std::vector<std::string> const expected_names {
+    "mimetype", "META-INF/container.xml", "score.xml"
+  };
+  BOOST_CHECK(names == expected_names);
+  BOOST_CHECK(score_xml == xml.str());
+}
+
+#include "bmc/midi.hpp"
+
+BOOST_AUTO_TEST_CASE(standard_midi_file) {
+  typedef std::wstring::const_iterator iterator_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  std::ifstream file{"input/bwv988-v01.bmc"};
+  BOOST_REQUIRE(file.good());
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  auto const input = utf_to_utf<wchar_t>(std::string(file_begin, file_end));
+  iterator_type begin(input.begin());
+  iterator_type const end(input.end());
+  error_handler_type errors(begin, end);
+  ::bmc::braille::ast::score score;
+  BOOST_REQUIRE(::bmc::braille::score_parser<iterator_type>()(begin, end, errors, score));
+  ::bmc::braille::compiler<error_handler_type> compile(errors);
+  BOOST_REQUIRE(compile(score));
+
+  std::stringstream stream;
+  ::bmc::midi::standard_midi_file(stream, score);
+  std::string const smf = stream.str();
+  auto const byte = [&smf](std::size_t at) {
+    return unsigned(static_cast<unsigned char>(smf[at]));
+  };
+  auto const u16 = [&byte](std::size_t at) {
+    return byte(at) << 8 | byte(at + 1);
+  };
+
+  BOOST_REQUIRE(smf.compare(0, 4, "MThd") == 0);
+  BOOST_CHECK_EQUAL(u16(8), 1U);
+  BOOST_REQUIRE_EQUAL(score.unfolded_part.size(), 1U);
+  auto const &staves = score.unfolded_part.front();
+  BOOST_CHECK_EQUAL(u16(10), 1 + staves.size());
+  unsigned const ppq = u16(12);
+
+  // Both halves of the variation are repeated.
+  ::bmc::rational length;
+  for (auto const &element: staves.front())
+    if (auto measure = boost::get<::bmc::braille::ast::unfolded::measure>(&element))
+      length += duration(*measure) * int(measure->count);
+  unsigned const expected_end = boost::rational_cast<unsigned>(2 * length * 4 * int(ppq));
+
+  std::size_t at = 14;
+  for (unsigned index = 0; index < u16(10); ++index) {
+    BOOST_REQUIRE(smf.compare(at, 4, "MTrk") == 0);
+    std::size_t const size = u16(at + 4) << 16 | u16(at + 6);
+    std::size_t const track_end = at + 8 + size;
+    BOOST_REQUIRE_LE(track_end, smf.size());
+    at += 8;
+    unsigned time = 0, on = 0, off = 0;
+    bool end_of_track = false;
+    while (at < track_end) {
+      BOOST_REQUIRE(!end_of_track);
+      unsigned delta = 0;
+      do delta = delta << 7 | (byte(at) & 0X7F); while (byte(at++) & 0X80);
+      time += delta;
+      unsigned const status = byte(at++);
+      if (status == 0XFF) {
+        end_of_track = byte(at) == 0X2F;
+        at += 2 + byte(at + 1);
+      } else {
+        switch (status & 0XF0) {
+        case 0X90: ++on; at += 2; break;
+        case 0X80: ++off; at += 2; break;
+        case 0XC0: at += 1; break;
+        default: BOOST_FAIL("Unexpected MIDI status");
+        }
+      }
+    }
+    BOOST_CHECK(end_of_track);
+    BOOST_CHECK_EQUAL(on, off);
+    if (index > 0) {
+      BOOST_CHECK_GT(on, 0U);
+      BOOST_CHECK_EQUAL(time, expected_end);
+    }
+  }
+  BOOST_CHECK_EQUAL(at, smf.size());
+}
+
+BOOST_AUTO_TEST_CASE(braille_table_per_parse) {
+  typedef std::wstring::const_iterator iterator_type;
+  typedef ::bmc::braille::error_handler<iterator_type> error_handler_type;
+  using ::bmc::braille::braille_table;
+  using ::bmc::braille::get_braille_table;
+  ::bmc::braille::score_parser<iterator_type> const parser;
+
+  std::ifstream file{"input/bwv988-v10.bmc"};
+  BOOST_REQUIRE(file.good());
+  std::istreambuf_iterator<char> file_begin{file.rdbuf()}, file_end{};
+  auto const braille = utf_to_utf<wchar_t>(std::string(file_begin, file_end));
+
+  // Spell the Unicode braille input with the characters of a text table.
+  auto const to_text = [&braille](braille_table const &table) {
+    std::wstring text(braille);
+    for (wchar_t &c: text) {
+      if ((c & ~0XFF) == 0X2800) {
+        wchar_t t = 0X20;
+        for (; t < 0X100; ++t) {
+          std::wstring cell(1, t);
+          table.to_unicode_braille(cell);
+          if (cell[0] == c) break;
+        }
+        BOOST_REQUIRE(t < 0X100);
+        c = t;
+      }
+    }
+    return text;
+  };
+
+  auto const to_lilypond = [&parser](std::wstring const &input,
+                                     braille_table const &table) {
+    iterator_type begin(input.begin());
+    iterator_type const end(input.end());
+    error_handler_type errors(begin, end);
+    ::bmc::braille::ast::score score;
+    std::stringstream ly;
+    if (parser(begin, end, errors, score, table) && begin == end) {
+      ::bmc::braille::compiler<error_handler_type> compile(errors);
+      if (compile(score)) {
+        ::bmc::lilypond_output_format(ly);
+        ly << score;
+      }
+    }
+    return ly.str();
+  };
+
+  // The global default stays "de" throughout.
+  std::vector<std::future<std::string>> results;
+  for (char const *name: {"brf", "de", "brf", "de"}) {
+    braille_table const &table = get_braille_table(name);
+    results.push_back(std::async(std::launch::async,
+                                 to_lilypond, to_text(table), std::cref(table)));
+  }
+  for (auto &result: results) {
+    output_test_stream ts{"output/bwv988-v10.ly"};
+    ts << result.get();
+    BOOST_CHECK(ts.match_pattern());
+  }
+
+  BOOST_CHECK(braille_table::scoped() == nullptr);
+  {
+    braille_table::scope const brf(get_braille_table("brf"));
+    BOOST_CHECK(&::bmc::braille::current_braille_table() ==
+                &get_braille_table("brf"));
+    {
+      braille_table::scope const de(get_braille_table("de"));
+      BOOST_CHECK(braille_table::scoped() == &get_braille_table("de"));
+    }
+    BOOST_CHECK(braille_table::scoped() == &get_braille_table("brf"));
+  }
+  BOOST_CHECK(&::bmc::braille::current_braille_table() ==
+              &get_braille_table("de"));
+}
+
 BOOST_AUTO_TEST_CASE(bwv988_v11) {
   std::ifstream file{"input/bwv988-v11.bmc"};
   BOOST_REQUIRE(file.good());
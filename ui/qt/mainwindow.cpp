@@ -34,6 +34,7 @@
 #include <boost/spirit/include/qi_core.hpp>
 #include <bmc/braille/parsing/grammar/score.hpp>
 #include <bmc/braille/semantic_analysis.hpp>
+#include <bmc/braille/text2braille.hpp>
 #include <bmc/braille/reformat.hpp>
 #include <bmc/musicxml.hpp>
 #include <bmc/lilypond.hpp>
@@ -417,6 +418,8 @@ void BrailleMusicEditor::fileCompile() {
   // MSVC crashes if we attempt to use toStdWString.
   input = (wchar_t const *)textEdit->toPlainText().utf16();
 #endif
+  ::bmc::braille::get_braille_table(::bmc::braille::default_table)
+  .to_unicode_braille(input);
   typedef std::wstring::const_iterator iterator_type;
   iterator_type begin(input.begin());
   iterator_type const end(input.end());